@@ -10,6 +10,40 @@
 #include <filesystem>   // C++17
 #include <fstream>
 #include <system_error>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#if __has_include(<charconv>)
+#include <charconv>     // std::from_chars
+#endif
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>    // file mapping
+#else
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef THICKLINE_BENCH
+#include <map>
+#include <new>
+#include <random>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#endif
 
 using namespace adsk::core;
 using namespace adsk::fusion;
@@ -17,6 +51,31 @@ using namespace adsk::fusion;
 Ptr<Application> _app;
 Ptr<UserInterface> _ui;
 
+#ifdef THICKLINE_BENCH
+// Counting allocator (benchmark builds only): counts every operator new of the add-in
+static std::atomic<size_t> g_AllocCount{ 0 };
+static std::atomic<size_t> g_AllocBytes{ 0 };
+
+void* operator new(std::size_t n)
+{
+    g_AllocCount.fetch_add(1, std::memory_order_relaxed);
+    g_AllocBytes.fetch_add(n, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Allocations since a starting point
+struct AllocCounter {
+    size_t count0 = g_AllocCount.load();
+    size_t bytes0 = g_AllocBytes.load();
+    size_t count() const { return g_AllocCount.load() - count0; }
+    size_t bytes() const { return g_AllocBytes.load() - bytes0; }
+};
+#endif
+
 // IDs for the input fields
 static const char* kGraphic = "tl_graphic";
 
@@ -26,7 +85,9 @@ static const char* kSeparator2 = "tl_sep2";
 static const char* kGroupA = "tl_groupA";
 static const char* kGroupB = "tl_groupB";
 
+static const char* kModeId = "tl_mode";
 static const char* kWidthId = "tl_width";
+static const char* kCapFilletId = "tl_capFillet";
 
 static const char* kSelPointAId = "tl_selPointA";
 static const char* kLeadAId = "tl_leadA";
@@ -40,14 +101,165 @@ static const char* kFeatBTypeId = "tl_featB_type";
 static const char* kFeatBWidthId = "tl_featB_width";
 static const char* kFeatBLengthId = "tl_featB_length";
 
+static const char* kGroupMarkers = "tl_groupMarkers";
+static const char* kMarkerSpacingId = "tl_markerSpacing";
+static const char* kMarkerWidthId = "tl_markerWidth";
+static const char* kMarkerLengthId = "tl_markerLength";
+
+static const char* kGroupSweep = "tl_groupSweep";
+static const char* kSweepToPrefix = "tl_sweepTo_";       // + sweepParamKey
+static const char* kSweepStepsPrefix = "tl_sweepSteps_"; // + sweepParamKey
+static const char* kSweepGapId = "tl_sweepGap";
+
+static const char* kGroupExtrude = "tl_groupExtrude";
+static const char* kExtrudeId = "tl_extrude";
+static const char* kExtrudeDistId = "tl_extrudeDist";
+
 static const char* kErrorBox = "tl_errorBox";
 
 // small numeric thresholds used everywhere
 constexpr double kEpsCoincident = 1e-12; // point equality / normalization safety
 constexpr double kEpsSketchLen = 1e-9;  // geometry construction guards
 
+// Ways of turning outlines into sketch entities
+enum class EmitStrategy {
+    ThreePointRect = 0, // rectangles via addThreePointRectangle, other outlines edge by edge
+    TwoPointLines,      // every edge via addByTwoPoints with its own end points
+    SharedPoints,       // every edge via addByTwoPoints, reusing the previous edge's end SketchPoint
+    Count
+};
+
+inline const char* emitStrategyName(EmitStrategy s)
+{
+    switch (s) {
+    case EmitStrategy::TwoPointLines: return "TwoPointLines";
+    case EmitStrategy::SharedPoints:  return "SharedPoints";
+    default:                          return "ThreePointRect";
+    }
+}
+
+inline EmitStrategy emitStrategyFromName(const std::string& name)
+{
+    for (int i = 0; i < (int)EmitStrategy::Count; ++i)
+        if (name == emitStrategyName((EmitStrategy)i))
+            return (EmitStrategy)i;
+    return EmitStrategy::ThreePointRect;
+}
+
+// Fusion API calls made while emitting (keys of the cost model)
+enum class ApiCall {
+    Point3DCreate = 0,
+    AddThreePointRectangle,
+    AddByTwoPoints,
+    AddArcByThreePoints,
+    AddCircle,
+    IsFixed,         // fixing a line right after creating it
+    IsFixedDeferred, // fixing a line after the whole batch, with sketch compute deferred
+    Count
+};
+
+inline const char* apiCallName(ApiCall c)
+{
+    switch (c) {
+    case ApiCall::Point3DCreate:          return "Point3DCreate";
+    case ApiCall::AddThreePointRectangle: return "AddThreePointRectangle";
+    case ApiCall::AddByTwoPoints:         return "AddByTwoPoints";
+    case ApiCall::AddArcByThreePoints:    return "AddArcByThreePoints";
+    case ApiCall::AddCircle:              return "AddCircle";
+    case ApiCall::IsFixed:                return "IsFixed";
+    default:                              return "IsFixedDeferred";
+    }
+}
+
+// Number of calls and time spent per API call type
+struct ApiCallTally {
+    size_t calls[(int)ApiCall::Count] = {};
+    double seconds[(int)ApiCall::Count] = {};
+
+    size_t totalCalls() const
+    {
+        size_t n = 0;
+        for (size_t c : calls) n += c;
+        return n;
+    }
+};
+
+// Sketch size buckets (decades of sketch curves): <10, <100, <1k, <10k, <100k, >=100k
+constexpr int kCostBuckets = 6;
+
+inline int sketchSizeBucket(size_t curves)
+{
+    int b = 0;
+    while (curves >= 10 && b < kCostBuckets - 1) { curves /= 10; ++b; }
+    return b;
+}
+
+// Cost model: microseconds per API call, per call type and sketch size bucket.
+// Starts from rough defaults; every emit blends its measured timings in.
+struct EmitCostModel {
+    double us[kCostBuckets][(int)ApiCall::Count];
+    bool measured[kCostBuckets][(int)ApiCall::Count];
+
+    EmitCostModel()
+    {
+        // rough defaults; calls get slower as the sketch grows (solver and profile updates)
+        const double base[(int)ApiCall::Count] = { 2.0, 4000.0, 1500.0, 2000.0, 1500.0, 400.0, 60.0 };
+        for (int b = 0; b < kCostBuckets; ++b)
+            for (int c = 0; c < (int)ApiCall::Count; ++c) {
+                us[b][c] = c == (int)ApiCall::Point3DCreate ? base[c] : base[c] * (1.0 + 0.75 * b);
+                measured[b][c] = false;
+            }
+    }
+
+    // Blend measured timings of one emit into the model
+    void observe(int bucket, const ApiCallTally& t)
+    {
+        for (int c = 0; c < (int)ApiCall::Count; ++c) {
+            if (t.calls[c] == 0)
+                continue;
+            double perCall = t.seconds[c] * 1e6 / (double)t.calls[c];
+            us[bucket][c] = measured[bucket][c] ? 0.7 * us[bucket][c] + 0.3 * perCall : perCall;
+            measured[bucket][c] = true;
+        }
+    }
+
+    // Projected wall time (seconds) for a set of calls
+    double projectSeconds(int bucket, const ApiCallTally& t) const
+    {
+        double s = 0;
+        for (int c = 0; c < (int)ApiCall::Count; ++c)
+            s += (double)t.calls[c] * us[bucket][c] * 1e-6;
+        return s;
+    }
+};
+
 // Default settings (structure)
+// Sizes a sweep can vary (see buildSweep)
+enum class SweepParam { Width = 0, LeadA, LeadB, FeatAW, FeatAL, FeatBW, FeatBL, Count };
+constexpr int kSweepParams = (int)SweepParam::Count;
+
+inline const char* sweepParamKey(int p)
+{
+    static const char* keys[kSweepParams] = { "width", "leadA", "leadB", "featAW", "featAL", "featBW", "featBL" };
+    return keys[p];
+}
+
+inline const char* sweepParamLabel(int p)
+{
+    static const char* labels[kSweepParams] = { "Width", "Lead A", "Lead B", "Feature A Width", "Feature A Length",
+                                                "Feature B Width", "Feature B Length" };
+    return labels[p];
+}
+
+// Ranges of a sweep: every size goes from its dialog value to 'to' in 'steps' steps (1 = fixed)
+struct SweepSpec {
+    double to[kSweepParams] = {};
+    int steps[kSweepParams] = { 1, 1, 1, 1, 1, 1, 1 };
+    double gapCm = 0.2; // free space between neighbouring variants
+};
+
 struct ThickLineSettings {
+    std::string mode = "Single";  // "Single", "Hub", "Sweep" or "Chain"
     double width_cm = 0.2;
 	std::string featAType = "None";
     double leadA_cm = 0;
@@ -57,6 +269,32 @@ struct ThickLineSettings {
     double leadB_cm = 0;
     double featBL_cm = 0.5;
     double featBW_cm = 0.5;
+    double capFillet_cm = 0;
+    double markerSpacing_cm = 0; // 0 = no direction markers
+    double markerW_cm = 0.4;
+    double markerL_cm = 0.3;
+    SweepSpec sweep;
+    bool extrude = false;        // one extrude feature for all created profiles
+    double extrudeDist_cm = 0.1;
+    double coverageTile_cm = 0.5; // coverage map tiles
+    int coverageSamples = 32;
+
+    // kerf / etch compensation per output (no UI, edit settings.ini): signed offset, > 0 grows
+    double kerfSketch_cm = 0;
+    double kerfCoverage_cm = 0;
+    double kerfExport_cm = 0;
+    bool kerfRoundJoins = true;                    // arcs where the offset opens a sharp corner (else mitres)
+    int exportShardBudgetMB = 16;                  // DXF export: text buffered per worker before writing
+
+    // emission (no UI, edit settings.ini to change)
+    EmitStrategy emitStrategy = EmitStrategy::ThreePointRect;
+    bool emitDeferFix = false;
+    bool emitAutoTune = true;                      // time strategies on large batches, keep the fastest
+    bool tunedSet[kCostBuckets] = {};              // per sketch size bucket: fastest strategy found so far
+    EmitStrategy tuned[kCostBuckets] = {};
+    EmitCostModel cost;
+
+    unsigned workerThreads = 0; // geometry worker threads, 0 = one per core
 };
 
 // Get path to application data directory for this add-in
@@ -79,15 +317,25 @@ inline std::filesystem::path settingsPath()
     return appDataDir() / "settings.ini";
 }
 
+// Settings read last, reused while settings.ini is unchanged (dialogs, previews and indexes all ask)
+static struct SettingsCache {
+    bool valid = false;
+    std::filesystem::file_time_type time;
+    uintmax_t size = 0;
+    ThickLineSettings s;
+} g_SettingsCache;
+
 // Save settings to INI file
 inline bool saveSettingsIni(const ThickLineSettings& s)
 {
     std::error_code ec;
     std::filesystem::create_directories(appDataDir(), ec);
 
+    g_SettingsCache.valid = false;
     std::ofstream f(settingsPath(), std::ios::trunc);
     if (!f) return false;
 
+    f << "mode=" << s.mode << "\n";
     f << "width_cm=" << s.width_cm << "\n";
 
     f << "featAType=" << s.featAType << "\n";
@@ -99,12 +347,44 @@ inline bool saveSettingsIni(const ThickLineSettings& s)
     f << "leadB_cm=" << s.leadB_cm << "\n";
     f << "featBL_cm=" << s.featBL_cm << "\n";
     f << "featBW_cm=" << s.featBW_cm << "\n";
+    f << "capFillet_cm=" << s.capFillet_cm << "\n";
+    f << "markerSpacing_cm=" << s.markerSpacing_cm << "\n";
+    f << "markerW_cm=" << s.markerW_cm << "\n";
+    f << "markerL_cm=" << s.markerL_cm << "\n";
+    for (int p = 0; p < kSweepParams; ++p) {
+        f << "sweepTo_" << sweepParamKey(p) << "=" << s.sweep.to[p] << "\n";
+        f << "sweepSteps_" << sweepParamKey(p) << "=" << s.sweep.steps[p] << "\n";
+    }
+    f << "sweepGap_cm=" << s.sweep.gapCm << "\n";
+    f << "extrude=" << (s.extrude ? 1 : 0) << "\n";
+    f << "extrudeDist_cm=" << s.extrudeDist_cm << "\n";
+    f << "coverageTile_cm=" << s.coverageTile_cm << "\n";
+    f << "coverageSamples=" << s.coverageSamples << "\n";
+    f << "kerfSketch_cm=" << s.kerfSketch_cm << "\n";
+    f << "kerfCoverage_cm=" << s.kerfCoverage_cm << "\n";
+    f << "kerfExport_cm=" << s.kerfExport_cm << "\n";
+    f << "kerfRoundJoins=" << (s.kerfRoundJoins ? 1 : 0) << "\n";
+    f << "exportShardBudgetMB=" << s.exportShardBudgetMB << "\n";
+
+    f << "emitStrategy=" << emitStrategyName(s.emitStrategy) << "\n";
+    f << "emitDeferFix=" << (s.emitDeferFix ? 1 : 0) << "\n";
+    f << "workerThreads=" << s.workerThreads << "\n";
+    f << "emitAutoTune=" << (s.emitAutoTune ? 1 : 0) << "\n";
+    for (int b = 0; b < kCostBuckets; ++b)
+        if (s.tunedSet[b])
+            f << "emitTuned_" << b << "=" << emitStrategyName(s.tuned[b]) << "\n";
+
+    // only measured cost entries, the rest stays at the defaults
+    for (int b = 0; b < kCostBuckets; ++b)
+        for (int c = 0; c < (int)ApiCall::Count; ++c)
+            if (s.cost.measured[b][c])
+                f << "cost_" << apiCallName((ApiCall)c) << "_" << b << "=" << s.cost.us[b][c] << "\n";
 
     return true;
 }
 
-// Load settings from INI file
-inline ThickLineSettings loadSettingsIni()
+// Parse settings.ini (defaults for what it lacks)
+inline ThickLineSettings readSettingsIni()
 {
     ThickLineSettings s; // defaults
     std::ifstream f(settingsPath());
@@ -119,8 +399,30 @@ inline ThickLineSettings loadSettingsIni()
         std::string value = line.substr(pos + 1);
 
         try {
-            if (key == "featAType")      s.featAType = value;
+            if (key == "mode")           s.mode = value;
+            else if (key == "featAType") s.featAType = value;
             else if (key == "featBType") s.featBType = value;
+            else if (key == "emitStrategy") s.emitStrategy = emitStrategyFromName(value);
+            else if (key.compare(0, 10, "emitTuned_") == 0)
+            {
+                int b = std::stoi(key.substr(10));
+                if (b >= 0 && b < kCostBuckets) {
+                    s.tuned[b] = emitStrategyFromName(value);
+                    s.tunedSet[b] = true;
+                }
+            }
+            else if (key.compare(0, 5, "cost_") == 0)
+            {
+                // cost_<ApiCall>_<bucket>
+                auto us = key.rfind('_');
+                std::string call = key.substr(5, us - 5);
+                int b = std::stoi(key.substr(us + 1));
+                for (int c = 0; c < (int)ApiCall::Count; ++c)
+                    if (call == apiCallName((ApiCall)c) && b >= 0 && b < kCostBuckets) {
+                        s.cost.us[b][c] = std::stod(value);
+                        s.cost.measured[b][c] = true;
+                    }
+            }
             else
             {
                 double v = std::stod(value);
@@ -131,6 +433,28 @@ inline ThickLineSettings loadSettingsIni()
                 else if (key == "featAW_cm") s.featAW_cm = v;
                 else if (key == "featBL_cm") s.featBL_cm = v;
                 else if (key == "featBW_cm") s.featBW_cm = v;
+                else if (key == "capFillet_cm") s.capFillet_cm = v;
+                else if (key == "markerSpacing_cm") s.markerSpacing_cm = v;
+                else if (key == "markerW_cm") s.markerW_cm = v;
+                else if (key == "markerL_cm") s.markerL_cm = v;
+                else if (key == "emitDeferFix") s.emitDeferFix = v != 0;
+                else if (key == "emitAutoTune") s.emitAutoTune = v != 0;
+                else if (key == "workerThreads") s.workerThreads = v > 0 ? (unsigned)v : 0;
+                else if (key == "sweepGap_cm") s.sweep.gapCm = v;
+                else if (key == "extrude") s.extrude = v != 0;
+                else if (key == "extrudeDist_cm") s.extrudeDist_cm = v;
+                else if (key == "coverageTile_cm") s.coverageTile_cm = v;
+                else if (key == "coverageSamples") s.coverageSamples = std::max(1, (int)v);
+                else if (key == "kerfSketch_cm") s.kerfSketch_cm = v;
+                else if (key == "kerfCoverage_cm") s.kerfCoverage_cm = v;
+                else if (key == "kerfExport_cm") s.kerfExport_cm = v;
+                else if (key == "kerfRoundJoins") s.kerfRoundJoins = v != 0;
+                else if (key == "exportShardBudgetMB") s.exportShardBudgetMB = std::max(1, (int)v);
+                else
+                    for (int p = 0; p < kSweepParams; ++p) {
+                        if (key == std::string("sweepTo_") + sweepParamKey(p)) s.sweep.to[p] = v;
+                        else if (key == std::string("sweepSteps_") + sweepParamKey(p)) s.sweep.steps[p] = std::max(1, (int)v);
+                    }
             }
         }
         catch (...) {
@@ -140,6 +464,24 @@ inline ThickLineSettings loadSettingsIni()
     return s;
 }
 
+// Load settings from INI file (or use default values)
+inline ThickLineSettings loadSettingsIni()
+{
+    std::error_code ec;
+    const std::filesystem::path path = settingsPath();
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+    uintmax_t size = ec ? 0 : std::filesystem::file_size(path, ec);
+    if (ec)
+        return ThickLineSettings();
+    if (!g_SettingsCache.valid || g_SettingsCache.time != time || g_SettingsCache.size != size) {
+        g_SettingsCache.s = readSettingsIni();
+        g_SettingsCache.time = time;
+        g_SettingsCache.size = size;
+        g_SettingsCache.valid = true;
+    }
+    return g_SettingsCache.s;
+}
+
 // Helper: log message to Fusion console
 inline void LogFusion(const std::string& s)
 {
@@ -202,9 +544,136 @@ inline void updateFeatureInputs(const Ptr<CommandInputs>& inputs, const char* dd
 
     Ptr<ListItem> sel = dd->selectedItem();
     bool isNone = !sel || sel->index() == 0; // index 0 == "None"
+    bool noLength = isNone || sel->name() == "Pad"; // a pad only has a diameter
 
     if (w->isEnabled() == isNone) w->isEnabled(!isNone);
-    if (l->isEnabled() == isNone) l->isEnabled(!isNone);
+    if (l->isEnabled() == noLength) l->isEnabled(!noLength);
+}
+
+// Input of a type by id, nullptr when it is missing (groups built lazily) or of another type
+template <class T>
+inline Ptr<T> inputById(const Ptr<CommandInputs>& inputs, const std::string& id)
+{
+    Ptr<CommandInput> in = inputs ? inputs->itemById(id) : nullptr;
+    return in ? in->cast<T>() : nullptr;
+}
+
+// ---- Rarely used groups, filled when first expanded or shown ----
+// Until then their values are the saved settings, which is what the inputs would show.
+
+inline void addMarkerInputs(const Ptr<CommandInputs>& giM, const ThickLineSettings& S)
+{
+    Ptr<ValueCommandInput> mS = giM->addValueInput(kMarkerSpacingId, "Marker Spacing", "mm", ValueInput::createByReal(S.markerSpacing_cm));
+    mS->minimumValue(0.0);
+    mS->tooltip("Distance between arrows pointing from A to B along the line (0 = no markers)");
+    Ptr<ValueCommandInput> mW = giM->addValueInput(kMarkerWidthId, "Marker Width", "mm", ValueInput::createByReal(S.markerW_cm));
+    Ptr<ValueCommandInput> mL = giM->addValueInput(kMarkerLengthId, "Marker Length", "mm", ValueInput::createByReal(S.markerL_cm));
+    mW->minimumValue(0.0);
+    mL->minimumValue(0.0);
+}
+
+inline void addSweepInputs(const Ptr<CommandInputs>& giS, const ThickLineSettings& S)
+{
+    for (int p = 0; p < kSweepParams; ++p)
+    {
+        Ptr<ValueCommandInput> to = giS->addValueInput(kSweepToPrefix + std::string(sweepParamKey(p)), std::string(sweepParamLabel(p)) + " To",
+                                                       "mm", ValueInput::createByReal(S.sweep.to[p]));
+        to->minimumValue(0.0);
+        giS->addIntegerSpinnerCommandInput(kSweepStepsPrefix + std::string(sweepParamKey(p)), std::string(sweepParamLabel(p)) + " Steps",
+                                           1, 100, 1, S.sweep.steps[p]);
+    }
+    Ptr<ValueCommandInput> gap = giS->addValueInput(kSweepGapId, "Gap", "mm", ValueInput::createByReal(S.sweep.gapCm));
+    gap->minimumValue(0.0);
+}
+
+inline void addExtrudeInputs(const Ptr<CommandInputs>& giE, const ThickLineSettings& S)
+{
+    Ptr<BoolValueCommandInput> ext = giE->addBoolValueInput(kExtrudeId, "Extrude", true, "", S.extrude);
+    ext->tooltip("Extrude all created profiles as new bodies, in a single feature");
+    Ptr<ValueCommandInput> dist = giE->addValueInput(kExtrudeDistId, "Distance", "mm", ValueInput::createByReal(S.extrudeDist_cm));
+    dist->minimumValue(0.0);
+}
+
+// Fill one of the lazy groups if it is still empty
+inline void ensureGroupInputs(const Ptr<GroupCommandInput>& group)
+{
+    Ptr<CommandInputs> children = group ? group->children() : nullptr;
+    if (!children || children->count() > 0)
+        return;
+    const std::string id = group->id();
+    if (id == kGroupMarkers)
+        addMarkerInputs(children, loadSettingsIni());
+    else if (id == kGroupSweep)
+        addSweepInputs(children, loadSettingsIni());
+    else if (id == kGroupExtrude)
+        addExtrudeInputs(children, loadSettingsIni());
+}
+
+// Helper: one or many B points and no lead at the hub, depending on the mode
+inline void updateModeInputs(const Ptr<CommandInputs>& inputs)
+{
+    Ptr<CommandInputs> all = inputs->command() ? inputs->command()->commandInputs() : inputs; // B and lead A live in groups
+    Ptr<DropDownCommandInput> mode = all->itemById(kModeId)->cast<DropDownCommandInput>();
+    Ptr<SelectionCommandInput> selB = all->itemById(kSelPointBId)->cast<SelectionCommandInput>();
+    Ptr<ValueCommandInput> leadA = all->itemById(kLeadAId)->cast<ValueCommandInput>();
+    if (!mode || !selB || !leadA)
+        return;
+
+    bool hub = mode->selectedItem() && mode->selectedItem()->index() == 1;
+    bool sweep = mode->selectedItem() && mode->selectedItem()->index() == 2;
+    bool chain = mode->selectedItem() && mode->selectedItem()->index() == 3;
+    bool many = hub || chain;
+    if (!many && selB->selectionCount() > 1)
+        selB->clearSelection();
+    selB->setSelectionLimits(many ? 1 : 0, many ? 0 : 1); // 0 = no upper limit
+    if (leadA->isEnabled() == hub) leadA->isEnabled(!hub);
+
+    Ptr<GroupCommandInput> sweepGroup = inputById<GroupCommandInput>(all, kGroupSweep);
+    if (sweep)
+        ensureGroupInputs(sweepGroup);
+    if (sweepGroup && sweepGroup->isVisible() != sweep)
+        sweepGroup->isVisible(sweep);
+}
+
+// 4x4 row-major transform of a point
+inline void transformPoint(const std::vector<double>& m, double x, double y, double z, double out[3])
+{
+    out[0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+    out[1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+    out[2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+}
+
+// Transforms of the occurrences selections come through, fetched once per command.
+// Batch selections from a sub-component then cost one transform fetch per occurrence.
+static struct OccurrenceTransforms {
+    std::unordered_map<std::string, std::vector<double>> byPath; // keyed by occurrence full path
+
+    const std::vector<double>* get(const Ptr<Occurrence>& occ)
+    {
+        std::string path = occ->fullPathName();
+        auto it = byPath.find(path);
+        if (it == byPath.end()) {
+            Ptr<Matrix3D> m = occ->transform2(); // occurrence -> root, through all its parents
+            std::vector<double> a = m ? m->asArray() : std::vector<double>();
+            if (a.size() != 16)
+                return nullptr;
+            it = byPath.emplace(path, std::move(a)).first;
+        }
+        return &it->second;
+    }
+
+    void clear() { byPath.clear(); }
+} g_OccTransforms;
+
+// Point of a native (component space) entity, moved into the assembly by its occurrence
+inline Ptr<Point3D> inOccurrence(const Ptr<Point3D>& p, const Ptr<Occurrence>& occ)
+{
+    const std::vector<double>* m = p ? g_OccTransforms.get(occ) : nullptr;
+    if (!m)
+        return nullptr;
+    double w[3];
+    transformPoint(*m, p->x(), p->y(), p->z(), w);
+    return Point3D::create(w[0], w[1], w[2]);
 }
 
 // Helper: get the 3D world point from a selected entity (SketchPoint, ConstructionPoint, or Vertex)
@@ -216,13 +685,25 @@ inline Ptr<Point3D> worldPointFromEntity(const Ptr<Base>& ent)
     if (sp)
         return sp->worldGeometry();  // Sketch points: world coords
 
+    // Construction points and vertices of other components come as proxies: read the native
+    // object and apply the (cached) occurrence transform
     Ptr<ConstructionPoint> cp = ent->cast<ConstructionPoint>();
-    if (cp)
+    if (cp) {
+        Ptr<Occurrence> occ = cp->assemblyContext();
+        Ptr<ConstructionPoint> native = occ ? cp->nativeObject() : nullptr;
+        if (native)
+            return inOccurrence(native->geometry(), occ);
         return cp->geometry();       // Construction points: world coords
+    }
 
     Ptr<BRepVertex> v = ent->cast<BRepVertex>();
-    if (v)
+    if (v) {
+        Ptr<Occurrence> occ = v->assemblyContext();
+        Ptr<BRepVertex> native = occ ? v->nativeObject() : nullptr;
+        if (native)
+            return inOccurrence(native->geometry(), occ);
         return v->geometry();         // Vertices: world coords
+    }
 
     return nullptr;
 }
@@ -264,6 +745,12 @@ struct ThickLineParams {
     double widthCm{ 0 };
     double leadACm{ 0 };
     double leadBCm{ 0 };
+    double capFilletCm{ 0 }; // fillet radius where the line meets a feature, and at outer chain joints (0 = sharp corners)
+
+    // Direction markers (arrows pointing A -> B) repeated along the line
+    double markerSpacingCm{ 0 }; // 0 = none
+    double markerWCm{ 0 };
+    double markerLCm{ 0 };
 
 	// Feature A
 	std::string featAType{ "None" };
@@ -289,8 +776,22 @@ struct ThickLineParams {
 	V2 Bbase{ }; // base of Feature B (along line)
 };
 
-// Extract parameters from the command inputs
-bool extractParams(const Ptr<CommandInputs>& inputs, ThickLineParams& P, std::string& err)
+bool computeDerived(ThickLineParams& P, std::string& err);
+
+// Read a selected point and convert it from world coordinates to sketch coordinates
+bool selectionPoint(const Ptr<SelectionCommandInput>& sel, size_t index, const Ptr<Sketch>& sketch, V2& out)
+{
+    Ptr<Selection> s = sel->selection(index);
+    Ptr<Point3D> p3 = s ? worldPointFromEntity(s->entity()) : nullptr;
+    if (!p3)
+        return false;
+    Ptr<Point3D> sp = sketch->modelToSketchSpace(p3);
+    out = v2(sp->x(), sp->y());
+    return true;
+}
+
+// Extract sketch, sizes and features (everything except the points) from the command inputs
+bool extractStyle(const Ptr<CommandInputs>& inputs, ThickLineParams& P, std::string& err)
 {
     // Sketch
     P.sketch = getActiveSketch();
@@ -307,6 +808,8 @@ bool extractParams(const Ptr<CommandInputs>& inputs, ThickLineParams& P, std::st
     P.widthCm = widthIn ? widthIn->value() : 0.0;
     P.leadACm = leadAIn ? leadAIn->value() : 0.0;
     P.leadBCm = leadBIn ? leadBIn->value() : 0.0;
+    Ptr<ValueCommandInput> filletIn = inputs->itemById(kCapFilletId)->cast<ValueCommandInput>();
+    P.capFilletCm = filletIn ? filletIn->value() : 0.0;
 
     // read feature types
     Ptr<DropDownCommandInput> ddA = inputs->itemById(kFeatATypeId)->cast<DropDownCommandInput>();
@@ -324,6 +827,31 @@ bool extractParams(const Ptr<CommandInputs>& inputs, ThickLineParams& P, std::st
     P.featBWCm = (P.featBType != "None" && featBWIn) ? featBWIn->value() : 0.0;
     P.featBLCm = (P.featBType != "None" && featBLIn) ? featBLIn->value() : 0.0;
 
+    // read direction markers (cm)
+    Ptr<ValueCommandInput> mSIn = inputById<ValueCommandInput>(inputs, kMarkerSpacingId);
+    Ptr<ValueCommandInput> mWIn = inputById<ValueCommandInput>(inputs, kMarkerWidthId);
+    Ptr<ValueCommandInput> mLIn = inputById<ValueCommandInput>(inputs, kMarkerLengthId);
+    if (mSIn) {
+        P.markerSpacingCm = mSIn->value();
+        P.markerWCm = (P.markerSpacingCm > 0 && mWIn) ? mWIn->value() : 0.0;
+        P.markerLCm = (P.markerSpacingCm > 0 && mLIn) ? mLIn->value() : 0.0;
+    }
+    else { // group not opened yet
+        ThickLineSettings S = loadSettingsIni();
+        P.markerSpacingCm = S.markerSpacing_cm;
+        P.markerWCm = P.markerSpacingCm > 0 ? S.markerW_cm : 0.0;
+        P.markerLCm = P.markerSpacingCm > 0 ? S.markerL_cm : 0.0;
+    }
+
+    return true;
+}
+
+// Extract parameters from the command inputs
+bool extractParams(const Ptr<CommandInputs>& inputs, ThickLineParams& P, std::string& err)
+{
+    if (!extractStyle(inputs, P, err))
+        return false;
+
     // Get selected points and convert from world coordinates to sketch coordinates
     Ptr<SelectionCommandInput> selA = inputs->itemById(kSelPointAId)->cast<SelectionCommandInput>();
     if (!selA || selA->selectionCount() == 0)
@@ -337,21 +865,23 @@ bool extractParams(const Ptr<CommandInputs>& inputs, ThickLineParams& P, std::st
         err = "Select point or entity for B.";
         return false;
     }
-    Ptr<Base> entA = selA->selection(0)->entity();
-    Ptr<Base> entB = selB->selection(0)->entity();
-    Ptr<Point3D> pA3 = worldPointFromEntity(entA);
-    Ptr<Point3D> pB3 = worldPointFromEntity(entB);
-    if (!pA3 || !pB3)
+    if (!selectionPoint(selA, 0, P.sketch, P.A))
+    {
+        err = "Could not read geometry for selection A. Please select a SketchPoint, ConstructionPoint, or Vertex.";
+        return false;
+    }
+    if (!selectionPoint(selB, 0, P.sketch, P.B))
     {
-        err = !pA3 ? "Could not read geometry for selection A. Please select a SketchPoint, ConstructionPoint, or Vertex."
-                   : "Could not read geometry for selection B. Please select a SketchPoint, ConstructionPoint, or Vertex.";
+        err = "Could not read geometry for selection B. Please select a SketchPoint, ConstructionPoint, or Vertex.";
         return false;
     }
-    Ptr<Point3D> sA = P.sketch->modelToSketchSpace(pA3);
-    Ptr<Point3D> sB = P.sketch->modelToSketchSpace(pB3);
-    P.A = v2(sA->x(), sA->y());
-    P.B = v2(sB->x(), sB->y());
 
+    return computeDerived(P, err);
+}
+
+// Compute direction vectors, extended points and feature bases from A, B and the sizes
+bool computeDerived(ThickLineParams& P, std::string& err)
+{
     // distance between 2 selected points
     V2 diff = vsub(P.B, P.A);
 
@@ -376,6 +906,9 @@ bool extractParams(const Ptr<CommandInputs>& inputs, ThickLineParams& P, std::st
     return true;
 }
 
+// Upper bound for direction markers on one line
+constexpr double kMaxMarkersPerLine = 10000;
+
 // Validate parameters for geometric consistency
 bool validateParams(const ThickLineParams& P, std::string& err)
 {
@@ -386,6 +919,12 @@ bool validateParams(const ThickLineParams& P, std::string& err)
         return false;
     }
 
+    if (P.capFilletCm < 0)
+    {
+        err = "Cap fillet radius must be >= 0.";
+        return false;
+    }
+
     // start and end points must not be coincident
     if (P.L <= kEpsCoincident)
     {
@@ -430,203 +969,4498 @@ bool validateParams(const ThickLineParams& P, std::string& err)
         return false;
     }
 
+    // Direction markers
+    if (P.markerSpacingCm < 0)
+    {
+        err = "Marker spacing must be >= 0.";
+        return false;
+    }
+    if (P.markerSpacingCm > 0)
+    {
+        if (P.markerWCm <= 0 || P.markerLCm <= 0)
+        {
+            err = "Marker width and length must be > 0.";
+            return false;
+        }
+        if (P.markerLCm > P.markerSpacingCm)
+        {
+            err = "Marker length must be <= marker spacing.";
+            return false;
+        }
+        if (segLenSigned / P.markerSpacingCm > kMaxMarkersPerLine)
+        {
+            err = "Marker spacing is too small for the line length.";
+            return false;
+        }
+    }
+
     return true;
 }
 
-// draw rectangle given 3 corners (in sketch space)
-inline void drawThreePointRect(const Ptr<Sketch>& sk, const V2& p0, const V2& p1, const V2& p3)
-{
-    if (!sk)
-        return;
+// Closed outline (in sketch space); the last point connects back to the first
+struct Outline {
+    bool isRect = false;  // rectangle: pts[0], pts[1] and pts[3] are the three-point-rectangle corners
+    std::vector<V2> pts;
+    std::vector<double> fillet; // per point: tangent arc radius at that corner (empty = all sharp)
+    double circleR = 0;         // > 0: circle of this radius around pts[0] instead of a polygon
+};
 
-    Ptr<SketchLines> lines = sk->sketchCurves()->sketchLines();
-    Ptr<SketchLineList> rect = lines->addThreePointRectangle(P2(p0), P2(p1), P2(p3));
+// Axis aligned box (in sketch space)
+struct Box2 {
+    double x0 = 1e300, y0 = 1e300, x1 = -1e300, y1 = -1e300;
+    bool empty() const { return x0 > x1; }
+    void add(const V2& p) { x0 = std::min(x0, p.x); y0 = std::min(y0, p.y); x1 = std::max(x1, p.x); y1 = std::max(y1, p.y); }
+    void add(const Box2& b) { x0 = std::min(x0, b.x0); y0 = std::min(y0, b.y0); x1 = std::max(x1, b.x1); y1 = std::max(y1, b.y1); }
+    bool overlaps(const Box2& b) const { return x0 <= b.x1 && b.x0 <= x1 && y0 <= b.y1 && b.y0 <= y1; }
+    V2 centre() const { return v2((x0 + x1) * 0.5, (y0 + y1) * 0.5); }
+};
 
-	rect->item(0)->isFixed(true);
-	rect->item(1)->isFixed(true);
-	rect->item(2)->isFixed(true);
-	rect->item(3)->isFixed(true);
+// Bounding box of an outline (fillets cut corners, so the corner points bound them)
+inline Box2 outlineBox(const Outline& o)
+{
+    Box2 b;
+    if (o.circleR > 0 && !o.pts.empty()) {
+        b.add(vsub(o.pts[0], v2(o.circleR, o.circleR)));
+        b.add(vadd(o.pts[0], v2(o.circleR, o.circleR)));
+    }
+    else
+        for (const V2& p : o.pts) b.add(p);
+    return b;
 }
 
-// draw triangle given 3 corners (in sketch space)
-inline void drawTriangle(const Ptr<Sketch>& sk, const V2& a, const V2& b, const V2& c)
+// circle given center and radius
+inline Outline circleOutline(const V2& c, double r)
 {
-    if (!sk)
-        return;
+    Outline o;
+    o.pts = { c };
+    o.circleR = r;
+    return o;
+}
 
-    Ptr<SketchLines> lines = sk->sketchCurves()->sketchLines();
-    Ptr<SketchLine> l1 = lines->addByTwoPoints(P2(a), P2(b));
-    Ptr<SketchLine> l2 = lines->addByTwoPoints(P2(b), P2(c));
-    Ptr<SketchLine> l3 = lines->addByTwoPoints(P2(c), P2(a));
+// rectangle given 3 corners (p0 is the corner between p1 and p3)
+inline Outline rectOutline(const V2& p0, const V2& p1, const V2& p3)
+{
+    Outline o;
+    o.isRect = true;
+    o.pts = { p0, p1, vadd(p1, vsub(p3, p0)), p3 };
+    return o;
+}
 
-	l1->isFixed(true);
-	l2->isFixed(true);
-	l3->isFixed(true);
+// triangle given 3 corners
+inline Outline triangleOutline(const V2& a, const V2& b, const V2& c)
+{
+    Outline o;
+    o.pts = { a, b, c };
+    return o;
 }
 
-// Debug: dump all inputs
-//inline void DumpInputs(const Ptr<CommandInputs>& ins, std::string_view tag)
-//{
-//    if (!ins) return;
-//    LogFusion(std::string("[DumpInputs] ") + std::string(tag));
-//    for (size_t i = 0; i < ins->count(); ++i) {
-//        auto ci = ins->item(i);
-//        if (!ci) continue;
-//        LogFusion(std::string("  id='") + ci->id() + "'  type=" + ci->objectType());
-//    }
-//}
+inline double vcross(const V2& a, const V2& b) { return a.x * b.y - a.y * b.x; }
 
-class ThickLineInputChangedEventHandler : public InputChangedEventHandler
+// Add a point to an outline, merging it with the previous one when they coincide (keeps the smaller radius)
+inline void outlineAdd(Outline& o, const V2& p, double fillet)
 {
-public:
-    void notify(const Ptr<InputChangedEventArgs>& eventArgs) override
-    {
-        Ptr<CommandInputs> inputs = eventArgs->inputs();
-        Ptr<CommandInput> changed = eventArgs->input();
-        if (!inputs || !changed)
-            return;
+    if (!o.pts.empty() && vlen(vsub(p, o.pts.back())) <= kEpsSketchLen) {
+        o.fillet.back() = std::min(o.fillet.back(), fillet);
+        return;
+    }
+    o.pts.push_back(p);
+    o.fillet.push_back(fillet);
+}
 
-        if (changed->id() == kSelPointAId)
-        {
-			Ptr<SelectionCommandInput> selA = changed->cast<SelectionCommandInput>();
-            if (selA && selA->selectionCount() == 1)
-            {
-                // User just finished picking point A -> set focus to point B
-                Ptr<CommandInputs> allInputs = inputs->command()->commandInputs(); // inputs only contains inputs of group A - need access to group B
-                if (!allInputs)
-                    return;
-                Ptr<SelectionCommandInput> selB = allInputs->itemById(kSelPointBId)->cast<SelectionCommandInput>();
-                if (selB)
-                    selB->hasFocus(true);
-            }
+// Drop closing duplicates and points in the middle of a straight edge
+inline void outlineClean(Outline& o)
+{
+    while (o.pts.size() > 1 && vlen(vsub(o.pts.front(), o.pts.back())) <= kEpsSketchLen) {
+        o.fillet.front() = std::min(o.fillet.front(), o.fillet.back());
+        o.pts.pop_back();
+        o.fillet.pop_back();
+    }
+    for (size_t i = 0; i < o.pts.size() && o.pts.size() > 3;) {
+        const size_t n = o.pts.size();
+        V2 a = vsub(o.pts[i], o.pts[(i + n - 1) % n]);
+        V2 b = vsub(o.pts[(i + 1) % n], o.pts[i]);
+        if (std::fabs(vcross(a, b)) <= kEpsSketchLen * (vlen(a) + vlen(b)) && vdot(a, b) > 0) {
+            o.pts.erase(o.pts.begin() + i);
+            o.fillet.erase(o.fillet.begin() + i);
         }
+        else
+            ++i;
+    }
+}
 
-        if (changed->id() == kFeatATypeId)
-            updateFeatureInputs(inputs, kFeatATypeId, kFeatAWidthId, kFeatALengthId);
+// Append the outline path around one end of the line: from the line side at +side, around the
+// feature, back to the line side at -side. The two line corners are the line-to-cap junctions.
+inline void appendCapPath(Outline& o, const ThickLineParams& P, const V2& base, const V2& tip, const V2& out, const V2& side,
+                          const std::string& type, double featW, double featL)
+{
+    const double hw = P.widthCm * 0.5;
+    const double fw = featW * 0.5;
+    const double r = type == "None" ? 0.0 : P.capFilletCm;
+
+    outlineAdd(o, vadd(base, vscale(side, hw)), r);
+    if (type == "Arrow") {
+        outlineAdd(o, vadd(base, vscale(side, fw)), 0);
+        outlineAdd(o, tip, 0);
+        outlineAdd(o, vsub(base, vscale(side, fw)), 0);
+    }
+    else if (type == "T") {
+        outlineAdd(o, vadd(base, vscale(side, fw)), 0);
+        outlineAdd(o, vadd(vadd(base, vscale(side, fw)), vscale(out, featL)), 0);
+        outlineAdd(o, vadd(vsub(base, vscale(side, fw)), vscale(out, featL)), 0);
+        outlineAdd(o, vsub(base, vscale(side, fw)), 0);
+    }
+    outlineAdd(o, vsub(base, vscale(side, hw)), r);
+}
 
-        if (changed->id() == kFeatBTypeId)
-            updateFeatureInputs(inputs, kFeatBTypeId, kFeatBWidthId, kFeatBLengthId);
+// Single outline of line plus features, with tangent fillets at the line-to-cap junctions
+inline Outline mergedOutline(const ThickLineParams& P)
+{
+    Outline o;
+    appendCapPath(o, P, P.Bbase, P.Bext, P.Ldir, P.Wdir, P.featBType, P.featBWCm, P.featBLCm);
+    appendCapPath(o, P, P.Abase, P.Aext, vscale(P.Ldir, -1.0), vscale(P.Wdir, -1.0), P.featAType, P.featAWCm, P.featALCm);
+    outlineClean(o);
+    return o;
+}
 
-        if (changed->id() == kWidthId)
-        {
-            Ptr<ValueCommandInput> widthIn = inputs->itemById(kWidthId)->cast<ValueCommandInput>();
-            double widthVal = widthIn ? widthIn->value() : 0.0;
+// Piece of an outline boundary: straight edge a-b, or tangent arc from a to b through mid
+struct OutlineSeg {
+    V2 a, b, mid;
+    bool arc;
+};
 
-            Ptr<ValueCommandInput> aW = inputs->itemById(kFeatAWidthId)->cast<ValueCommandInput>();
-            Ptr<ValueCommandInput> bW = inputs->itemById(kFeatBWidthId)->cast<ValueCommandInput>();
-            if (aW) aW->minimumValue(widthVal);
-            if (bW) bW->minimumValue(widthVal);
+// Boundary of an outline as edges and fillet arcs. Each fillet is trimmed to fit its two edges
+// (half an edge when the corner at the other end is filleted too).
+inline void outlineSegments(const Outline& o, std::vector<OutlineSeg>& segs)
+{
+    segs.clear();
+    if (o.circleR > 0 && !o.pts.empty()) {
+        // two half circles
+        const V2& c = o.pts[0];
+        const double r = o.circleR;
+        segs.push_back(OutlineSeg{ vadd(c, v2(r, 0)), vsub(c, v2(r, 0)), vadd(c, v2(0, r)), true });
+        segs.push_back(OutlineSeg{ vsub(c, v2(r, 0)), vadd(c, v2(r, 0)), vsub(c, v2(0, r)), true });
+        return;
+    }
+    const size_t n = o.pts.size();
+    std::vector<V2> tin(o.pts), tout(o.pts), mid(n);
+    std::vector<char> hasArc(n, 0);
+    auto radius = [&](size_t i) { return i < o.fillet.size() ? o.fillet[i] : 0.0; };
+
+    for (size_t i = 0; i < n; ++i) {
+        double r = radius(i);
+        if (r <= kEpsSketchLen)
+            continue;
+        const size_t ip = (i + n - 1) % n, in = (i + 1) % n;
+        const V2& V = o.pts[i];
+        V2 e1 = vsub(o.pts[ip], V), e2 = vsub(o.pts[in], V);
+        double l1 = vlen(e1), l2 = vlen(e2);
+        if (l1 <= kEpsSketchLen || l2 <= kEpsSketchLen)
+            continue;
+        V2 u1 = vscale(e1, 1.0 / l1), u2 = vscale(e2, 1.0 / l2);
+        double theta = std::acos(std::max(-1.0, std::min(1.0, vdot(u1, u2)))); // angle between the edges
+        if (theta < 1e-6 || theta > 3.14159265358979323846 - 1e-6)
+            continue;
+
+        double t = r / std::tan(theta * 0.5); // distance from corner to tangent points
+        double tmax = std::min(l1 * (radius(ip) > 0 ? 0.5 : 1.0), l2 * (radius(in) > 0 ? 0.5 : 1.0));
+        if (t > tmax) {
+            t = tmax;
+            r = t * std::tan(theta * 0.5);
         }
+        V2 bis = vadd(u1, u2);
+        bis = vscale(bis, 1.0 / vlen(bis));
+        V2 C = vadd(V, vscale(bis, r / std::sin(theta * 0.5)));
+        tin[i] = vadd(V, vscale(u1, t));
+        tout[i] = vadd(V, vscale(u2, t));
+        mid[i] = vsub(C, vscale(bis, r));
+        hasArc[i] = 1;
     }
-} _thickLineInputChangedHandler;
 
-class ThickLineValidateInputsEventHandler : public ValidateInputsEventHandler
-{
-public:
-    void notify(const Ptr<ValidateInputsEventArgs>& eventArgs) override
-    {
-        Ptr<CommandInputs> inputs = eventArgs->inputs();
-        if (!inputs)
-            return;
+    for (size_t i = 0; i < n; ++i) {
+        if (hasArc[i])
+            segs.push_back(OutlineSeg{ tin[i], tout[i], mid[i], true });
+        const V2& b = tin[(i + 1) % n];
+        if (vlen(vsub(b, tout[i])) > kEpsSketchLen)
+            segs.push_back(OutlineSeg{ tout[i], b, V2{ }, false });
+    }
+}
 
-		// Extract and validate parameters
-		ThickLineParams P;
-		std::string err;
-		bool ok = extractParams(inputs, P, err) && validateParams(P, err);
+// Curves one outline becomes (a circle is one curve, otherwise one per edge or fillet arc)
+inline size_t outlineCurveCount(const Outline& o)
+{
+    if (o.circleR > 0 && !o.pts.empty())
+        return 1;
+    if (o.pts.size() < 3)
+        return 0;
+    std::vector<OutlineSeg> segs;
+    outlineSegments(o, segs);
+    return segs.size();
+}
 
-		syncErrorBox(inputs, ok, err);
+// Direction marker arrows, spaced evenly along the segment between the feature bases. The arrow
+// template is built once in line coordinates (along, across) and placed at every position.
+inline void appendMarkers(const ThickLineParams& P, std::vector<Outline>& out)
+{
+    if (P.markerSpacingCm <= 0 || P.markerLCm <= 0)
+        return;
+    const double segLen = vdot(vsub(P.Bbase, P.Abase), P.Ldir);
+    const size_t count = (size_t)std::floor(segLen / P.markerSpacingCm + kEpsSketchLen);
+    if (count == 0)
+        return;
 
-		eventArgs->areInputsValid(ok);
+    const V2 arrow[3] = { v2(-P.markerLCm * 0.5, P.markerWCm * 0.5), v2(P.markerLCm * 0.5, 0), v2(-P.markerLCm * 0.5, -P.markerWCm * 0.5) };
+    V2 local[3];
+    for (int k = 0; k < 3; ++k)
+        local[k] = vadd(vscale(P.Ldir, arrow[k].x), vscale(P.Wdir, arrow[k].y));
+
+    // centre the row of markers on the segment
+    const double first = (segLen - (double)(count - 1) * P.markerSpacingCm) * 0.5;
+    out.reserve(out.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        V2 c = vadd(P.Abase, vscale(P.Ldir, first + (double)i * P.markerSpacingCm));
+        out.push_back(triangleOutline(vadd(c, local[0]), vadd(c, local[1]), vadd(c, local[2])));
     }
-} _thickLineValidateInputsHandler;
+}
+
+// Build the outlines of one thick line: main rectangle plus features at A and B
+// (one merged outline when the line-to-cap junctions are filleted), then direction markers
+inline void buildOutlines(const ThickLineParams& P, std::vector<Outline>& out)
+{
+    if (P.capFilletCm > 0 && (P.featAType != "None" || P.featBType != "None")) {
+        out.push_back(mergedOutline(P));
+        appendMarkers(P, out);
+        return;
+    }
+
+    // Half width vector
+    V2 wHalf = vscale(P.Wdir, P.widthCm * 0.5);
+
+    // --- main rectangle spans Abase <-> Bbase ---
+    V2 Aplus = vadd(P.Abase, wHalf);
+    V2 Aminus = vsub(P.Abase, wHalf);
+    V2 Bplus = vadd(P.Bbase, wHalf);
+
+    out.push_back(rectOutline(Aplus, Bplus, Aminus)); // ensures corners are closed
+
+    // --- feature at A (tip fixed at Aext, depth = featALCm) ---
+    if (P.featAType == "Arrow") {
+        V2 aSide = vscale(P.Wdir, P.featAWCm * 0.5);
+        V2 baseL = vadd(P.Abase, aSide);
+        V2 baseR = vadd(P.Abase, vscale(aSide, -1.0));
+        out.push_back(triangleOutline(baseL, P.Aext, baseR));
+    }
+    else if (P.featAType == "T") {
+        V2 aSide = vscale(P.Wdir, P.featAWCm * 0.5);
+        V2 aL0 = vadd(P.Abase, aSide);
+        V2 aR0 = vadd(P.Abase, vscale(aSide, -1.0));
+        V2 aL1 = vadd(aL0, vscale(P.Ldir, -P.featALCm)); // toward Aext
+        out.push_back(rectOutline(aL0, aL1, aR0)); // ensure corners are closed
+    }
+
+    // --- feature at B (tip fixed at Bext, depth = featBLCm) ---
+    if (P.featBType == "Arrow") {
+        V2 bSide = vscale(P.Wdir, P.featBWCm * 0.5);
+        V2 baseL = vadd(P.Bbase, bSide);
+        V2 baseR = vadd(P.Bbase, vscale(bSide, -1.0));
+        out.push_back(triangleOutline(baseL, P.Bext, baseR));
+    }
+    else if (P.featBType == "T") {
+        V2 bSide = vscale(P.Wdir, P.featBWCm * 0.5);
+        V2 bL0 = vadd(P.Bbase, bSide);
+        V2 bR0 = vadd(P.Bbase, vscale(bSide, -1.0));
+        V2 bL1 = vadd(bL0, vscale(P.Ldir, +P.featBLCm)); // toward Bext
+        out.push_back(rectOutline(bL0, bL1, bR0)); // ensure corners are closed
+    }
+
+    appendMarkers(P, out);
+}
+
+// Signed area of an outline's polygon (positive when counter-clockwise; fillets ignored)
+inline double outlineArea(const Outline& o)
+{
+    if (o.circleR > 0)
+        return 3.14159265358979323846 * o.circleR * o.circleR;
+    double a = 0;
+    for (size_t i = 0, n = o.pts.size(); i < n; ++i)
+        a += vcross(o.pts[i], o.pts[(i + 1) % n]);
+    return 0.5 * a;
+}
+
+// Hub and spokes: lines from one hub to many end points sharing a single junction, instead of
+// N line ends overlapping at the hub. Every spoke starts where it no longer overlaps its angular
+// neighbours; a junction polygon between the spoke starts closes the hub, or a pad circle whose
+// edge the spoke corners touch.
+inline bool buildHub(const ThickLineParams& style, const V2& hub, const std::vector<V2>& ends, double padDiameter,
+                     std::vector<ThickLineParams>& spokes, std::vector<Outline>& shared, std::string& err)
+{
+    const double kPi = 3.14159265358979323846;
+    const double hw = style.widthCm * 0.5;
+    const size_t n = ends.size();
+
+    // spokes in counter-clockwise order
+    std::vector<double> angle(n);
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        V2 d = vsub(ends[i], hub);
+        if (vlen(d) <= kEpsCoincident) {
+            err = "A spoke end point coincides with the hub.";
+            return false;
+        }
+        angle[i] = std::atan2(d.y, d.x);
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return angle[a] < angle[b]; });
+
+    // start distance: where the spoke stops overlapping the neighbours (only gaps < 180deg overlap)
+    auto gapAfter = [&](size_t k) { return n == 1 ? 2 * kPi : angle[order[(k + 1) % n]] - angle[order[k]] + (k + 1 == n ? 2 * kPi : 0.0); };
+    auto clearance = [&](double gap) { return gap < kPi - 1e-9 ? hw / std::tan(gap * 0.5) : 0.0; };
+    std::vector<double> start(n);
+    double maxStart = 0;
+    for (size_t k = 0; k < n; ++k) {
+        double before = gapAfter((k + n - 1) % n), after = gapAfter(k);
+        if (std::min(before, after) <= 1e-9) {
+            err = "Two spokes point in the same direction.";
+            return false;
+        }
+        start[k] = std::max(clearance(before), clearance(after));
+        maxStart = std::max(maxStart, start[k]);
+    }
+
+    // a pad replaces the junction polygon: spoke corners sit on its edge
+    const double R = padDiameter * 0.5;
+    if (R > 0) {
+        double need = std::sqrt(maxStart * maxStart + hw * hw);
+        if (R < need - kEpsSketchLen) {
+            std::ostringstream m;
+            m << "Pad diameter too small for the spoke spacing (needs >= " << std::fixed << std::setprecision(2) << 2 * need * 10.0 << " mm).";
+            err = m.str();
+            return false;
+        }
+        std::fill(start.begin(), start.end(), std::sqrt(R * R - hw * hw));
+    }
+
+    // spokes: B side as styled, plain start at the hub side
+    spokes.clear();
+    spokes.reserve(n);
+    std::vector<V2> dir(n);
+    for (size_t k = 0; k < n; ++k) {
+        const size_t i = order[k];
+        dir[k] = vscale(vsub(ends[i], hub), 1.0 / vlen(vsub(ends[i], hub)));
+
+        ThickLineParams P = style;
+        P.featAType = "None";
+        P.featAWCm = P.featALCm = P.leadACm = 0;
+        P.A = vadd(hub, vscale(dir[k], start[k]));
+        P.B = ends[i];
+        if (!computeDerived(P, err) || !validateParams(P, err)) {
+            err = "Spoke " + std::to_string(i + 1) + ": " + err;
+            return false;
+        }
+        spokes.push_back(P);
+    }
+
+    if (R > 0) {
+        shared.push_back(circleOutline(hub, R));
+        return true;
+    }
+    if (n < 2)
+        return true;
+
+    // junction: start edges of all spokes, plus the hub end of the spokes across gaps >= 180deg
+    Outline j;
+    for (size_t k = 0; k < n; ++k) {
+        V2 s = vadd(hub, vscale(dir[k], start[k]));
+        V2 side = vscale(vperp_ccw(dir[k]), hw);
+        outlineAdd(j, vsub(s, side), 0);
+        outlineAdd(j, vadd(s, side), 0);
+        if (gapAfter(k) >= kPi - 1e-9) {
+            const size_t k1 = (k + 1) % n;
+            outlineAdd(j, vadd(hub, side), 0);
+            outlineAdd(j, vsub(hub, vscale(vperp_ccw(dir[k1]), hw)), 0);
+        }
+    }
+    outlineClean(j);
+    if (j.pts.size() >= 3 && std::fabs(outlineArea(j)) > kEpsSketchLen)
+        shared.push_back(j);
+    return true;
+}
+
+// Outer joints longer than this many half widths are bevelled instead of mitred
+constexpr double kChainMitreLimit = 4.0;
+
+// Outline of a chain route (A -> B1 -> B2 ...), the union of its segments. Appending a point
+// only computes the one new joint, earlier joints stay cached; outline() then assembles all
+// cached joints, which is linear in the route length. Segments are joined with their neighbours
+// only; a route crossing itself is not unioned there. A segment whose inner trims (from the turns
+// at both its ends, on one side) add up to more than its length would fold the outline over
+// itself, so such a point is refused.
+class ChainUnion
+{
+public:
+    // Start over for a width; returns false for a zero width
+    bool reset(double widthCm)
+    {
+        hw_ = widthCm * 0.5;
+        pts_.clear();
+        dirs_.clear();
+        lens_.clear();
+        startTrim_.clear();
+        jointL_.clear();
+        jointR_.clear();
+        return hw_ > 0;
+    }
+
+    double width() const { return hw_ * 2; }
+    const std::vector<V2>& points() const { return pts_; }
+
+    // Append the next route point; false (and err) when it coincides with the last one, or when
+    // the turn there trims more off a segment than the segment has left. Nothing changes then.
+    bool append(const V2& p, std::string& err)
+    {
+        if (!pts_.empty()) {
+            V2 d = vsub(p, pts_.back());
+            double len = vlen(d);
+            if (len <= kEpsSketchLen)
+            {
+                err = "Chain point " + std::to_string(pts_.size() + 1) + " coincides with the point before.";
+                return false;
+            }
+            const V2 dir = vscale(d, 1.0 / len);
+            Joint left, right;
+            double trim[2] = { 0, 0 }; // inner trim of the new joint, left and right
+            if (!dirs_.empty()) {
+                makeJoint(dirs_.back(), dir, pts_.back(), left, right, trim);
+                const size_t k = dirs_.size() - 1; // segment before the new joint
+                for (int s = 0; s < 2; ++s)
+                    if (trim[s] > 0 && (startTrim_[k][s] + trim[s] > lens_[k] + kEpsSketchLen || trim[s] > len + kEpsSketchLen))
+                    {
+                        err = "Chain point " + std::to_string(pts_.size()) + " turns too sharply: the segments next to it "
+                              "are too short for the turn at this width.";
+                        return false;
+                    }
+                jointL_.push_back(std::move(left));
+                jointR_.push_back(std::move(right));
+            }
+            dirs_.push_back(dir);
+            lens_.push_back(len);
+            startTrim_.push_back({ trim[0], trim[1] });
+        }
+        pts_.push_back(p);
+        return true;
+    }
+
+    // The route outline with the leads at both ends (left side out, right side back); outer
+    // joints get tangent fillets of filletCm (0 = sharp)
+    Outline outline(double leadACm, double leadBCm, double filletCm) const
+    {
+        Outline o;
+        if (dirs_.empty())
+            return o;
+        const V2 d0 = dirs_.front(), dn = dirs_.back();
+        const V2 a = vsub(pts_.front(), vscale(d0, leadACm));
+        const V2 b = vadd(pts_.back(), vscale(dn, leadBCm));
+        o.pts.reserve(2 * pts_.size() + 4);
+        o.fillet.reserve(2 * pts_.size() + 4);
+        auto add = [&](const V2& q, double r) {
+            o.pts.push_back(q);
+            o.fillet.push_back(r);
+        };
+        add(vadd(a, vscale(vperp_ccw(d0), hw_)), 0);
+        for (const Joint& j : jointL_)
+            for (const V2& q : j.pts)
+                add(q, j.outer ? filletCm : 0);
+        add(vadd(b, vscale(vperp_ccw(dn), hw_)), 0);
+        add(vsub(b, vscale(vperp_ccw(dn), hw_)), 0);
+        for (size_t k = jointR_.size(); k-- > 0;)
+            for (size_t i = jointR_[k].pts.size(); i-- > 0;)
+                add(jointR_[k].pts[i], jointR_[k].outer ? filletCm : 0);
+        add(vsub(a, vscale(vperp_ccw(d0), hw_)), 0);
+        if (filletCm <= 0)
+            o.fillet.clear();
+        return o;
+    }
+
+private:
+    // Offset corner(s) of one side at a route point
+    struct Joint {
+        std::vector<V2> pts;
+        bool outer = false;
+    };
+
+    // Offset corners at route point v between incoming d0 and outgoing d1: the inner side is
+    // trimmed to the intersection of the offset edges (trim receives how far back along each
+    // segment, per side), the outer side mitred or bevelled
+    void makeJoint(const V2& d0, const V2& d1, const V2& v, Joint& left, Joint& right, double trim[2]) const
+    {
+        const V2 n0 = vperp_ccw(d0), n1 = vperp_ccw(d1);
+        const double turn = vcross(d0, d1); // > 0: left turn, the left side is inner
+        const V2 bis = vadd(n0, n1);
+        const double bl = vlen(bis);
+        const double cosHalf = bl * 0.5; // cos of half the turn angle
+        for (int s = 1; s >= -1; s -= 2) {
+            Joint& j = s > 0 ? left : right;
+            const bool inner = s * turn > 0;
+            j.outer = !inner && std::fabs(turn) > kEpsCoincident;
+            if (inner) // hw * tan(half turn); a reversal can never fit
+                trim[s > 0 ? 0 : 1] = cosHalf > kEpsCoincident ? hw_ * std::fabs(vcross(n0, bis)) / vdot(n0, bis) : 1e300;
+            if (bl > kEpsCoincident && (inner || 1.0 / cosHalf <= kChainMitreLimit) && cosHalf > kEpsCoincident)
+                j.pts.push_back(vadd(v, vscale(bis, s * hw_ / (bl * cosHalf))));
+            else {
+                j.pts.push_back(vadd(v, vscale(n0, s * hw_)));
+                j.pts.push_back(vadd(v, vscale(n1, s * hw_)));
+            }
+        }
+    }
+
+    double hw_ = 0;
+    std::vector<V2> pts_;
+    std::vector<V2> dirs_;                       // per segment
+    std::vector<double> lens_;
+    std::vector<std::array<double, 2>> startTrim_; // per segment: inner trim at its start, left and right
+    std::vector<Joint> jointL_;                  // per inner route point: left offset corner(s)
+    std::vector<Joint> jointR_;                  // right offset corner(s)
+};
+
+// Chain being drawn: kept between previews so each new point only adds its joint
+static ChainUnion g_Chain;
+
+// Build the chain outline (and direction markers per segment) for the points of a chain job
+inline bool buildChain(const ThickLineParams& style, const std::vector<V2>& pts, std::vector<Outline>& out, std::string& err)
+{
+    if (style.widthCm <= 0)
+    {
+        err = "Width of line must be > 0.";
+        return false;
+    }
+    if (style.featAType != "None" || style.featBType != "None")
+    {
+        err = "Features are not available in Chain mode (use the leads).";
+        return false;
+    }
+
+    // reuse the cached union when the route only grew
+    const std::vector<V2>& have = g_Chain.points();
+    bool prefix = g_Chain.width() == style.widthCm && have.size() <= pts.size() &&
+        std::equal(have.begin(), have.end(), pts.begin(), [](const V2& a, const V2& b) { return a.x == b.x && a.y == b.y; });
+    if (!prefix)
+        g_Chain.reset(style.widthCm);
+    for (size_t i = g_Chain.points().size(); i < pts.size(); ++i)
+        if (!g_Chain.append(pts[i], err))
+        {
+            g_Chain.reset(style.widthCm);
+            return false;
+        }
+    out.push_back(g_Chain.outline(style.leadACm, style.leadBCm, style.capFilletCm));
+
+    // direction markers per segment
+    for (size_t i = 0; style.markerSpacingCm > 0 && i + 1 < pts.size(); ++i)
+    {
+        ThickLineParams S = style;
+        S.A = pts[i];
+        S.B = pts[i + 1];
+        S.leadACm = S.leadBCm = 0;
+        if (!computeDerived(S, err) || !validateParams(S, err))
+        {
+            err = "Chain segment " + std::to_string(i + 1) + ": " + err;
+            return false;
+        }
+        appendMarkers(S, out);
+    }
+    return true;
+}
+
+// Upper bound for the number of variants of one sweep
+constexpr size_t kMaxSweepVariants = 10000;
+
+// Sweep: every combination of the swept sizes, laid out in a grid. Variant 0 sits on the selected
+// A and B; columns follow the line direction, rows go to its right. The pitch is the largest
+// variant extent plus the gap, so no two variants touch. Labels name the row and column.
+inline bool buildSweep(const ThickLineParams& base, const SweepSpec& spec, std::vector<ThickLineParams>& lines,
+                       std::vector<std::string>& labels, std::string& err)
+{
+    static double ThickLineParams::* const fields[kSweepParams] = {
+        &ThickLineParams::widthCm, &ThickLineParams::leadACm, &ThickLineParams::leadBCm,
+        &ThickLineParams::featAWCm, &ThickLineParams::featALCm, &ThickLineParams::featBWCm, &ThickLineParams::featBLCm };
+
+    size_t total = 1;
+    for (int p = 0; p < kSweepParams; ++p) {
+        if (spec.steps[p] < 1)
+        {
+            err = std::string(sweepParamLabel(p)) + " steps must be >= 1.";
+            return false;
+        }
+        bool featA = p == (int)SweepParam::FeatAW || p == (int)SweepParam::FeatAL;
+        bool featB = p == (int)SweepParam::FeatBW || p == (int)SweepParam::FeatBL;
+        if (spec.steps[p] > 1 && ((featA && base.featAType == "None") || (featB && base.featBType == "None")))
+        {
+            err = std::string(sweepParamLabel(p)) + " can only be swept with a feature selected.";
+            return false;
+        }
+        total *= (size_t)spec.steps[p];
+        if (total > kMaxSweepVariants)
+        {
+            err = "Sweep has too many variants (max " + std::to_string(kMaxSweepVariants) + ").";
+            return false;
+        }
+    }
+    if (spec.gapCm < 0)
+    {
+        err = "Sweep gap must be >= 0.";
+        return false;
+    }
+
+    // all variants on the base position first, measuring their extents along and across the line
+    std::vector<ThickLineParams> variants(total, base);
+    double lo[2] = { 1e300, 1e300 }, hi[2] = { -1e300, -1e300 };
+    std::vector<Outline> outlines;
+    for (size_t i = 0; i < total; ++i) {
+        ThickLineParams& P = variants[i];
+        size_t rest = i;
+        for (int p = 0; p < kSweepParams; ++p) {
+            int n = spec.steps[p];
+            int k = (int)(rest % (size_t)n);
+            rest /= (size_t)n;
+            if (n > 1)
+                P.*fields[p] += (spec.to[p] - P.*fields[p]) * k / (n - 1);
+        }
+        if (!computeDerived(P, err) || !validateParams(P, err))
+        {
+            err = "Sweep variant " + std::to_string(i + 1) + ": " + err;
+            return false;
+        }
+        outlines.clear();
+        buildOutlines(P, outlines);
+        for (const Outline& o : outlines)
+            for (const V2& q : o.pts) {
+                V2 d = vsub(q, P.A);
+                double r = o.circleR;
+                double t[2] = { vdot(d, P.Ldir), vdot(d, P.Wdir) };
+                for (int a = 0; a < 2; ++a) {
+                    lo[a] = std::min(lo[a], t[a] - r);
+                    hi[a] = std::max(hi[a], t[a] + r);
+                }
+            }
+    }
+
+    const size_t cols = (size_t)std::ceil(std::sqrt((double)total));
+    const double pitchL = hi[0] - lo[0] + spec.gapCm;
+    const double pitchW = hi[1] - lo[1] + spec.gapCm;
+    lines.reserve(lines.size() + total);
+    labels.reserve(labels.size() + total);
+    for (size_t i = 0; i < total; ++i) {
+        ThickLineParams P = variants[i];
+        size_t row = i / cols, col = i % cols;
+        V2 shift = vsub(vscale(P.Ldir, col * pitchL), vscale(P.Wdir, row * pitchW));
+        P.A = vadd(P.A, shift);
+        P.B = vadd(P.B, shift);
+        computeDerived(P, err);
+        lines.push_back(P);
+        labels.push_back("R" + std::to_string(row + 1) + "C" + std::to_string(col + 1));
+    }
+    return true;
+}
+
+// Write the sweep variants with their labels as CSV (sizes in cm, points in sketch space)
+inline bool writeSweepSpec(const std::filesystem::path& path, const std::vector<ThickLineParams>& lines,
+                           const std::vector<std::string>& labels)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream f(path, std::ios::trunc);
+    if (!f)
+        return false;
+    f << "label,ax,ay,bx,by,width,leadA,leadB,featA,featAW,featAL,featB,featBW,featBL,capFillet\n";
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const ThickLineParams& P = lines[i];
+        f << labels[i] << "," << P.A.x << "," << P.A.y << "," << P.B.x << "," << P.B.y << ","
+          << P.widthCm << "," << P.leadACm << "," << P.leadBCm << ","
+          << P.featAType << "," << P.featAWCm << "," << P.featALCm << ","
+          << P.featBType << "," << P.featBWCm << "," << P.featBLCm << "," << P.capFilletCm << "\n";
+    }
+    return (bool)f;
+}
+
+// Run fn(chunkIndex, begin, end) over [0, n) in fixed-size chunks on worker threads (0 = one per core).
+// Chunk boundaries depend only on n and chunk, never on the thread count, so per-chunk results
+// merged in chunk order (and reductions done in chunk order) are identical for any thread count.
+template <class Fn>
+inline void parallelChunks(size_t n, size_t chunk, unsigned threads, Fn fn)
+{
+    const size_t chunks = chunk ? (n + chunk - 1) / chunk : 0;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = (unsigned)std::min<size_t>(threads, chunks);
+
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&]()
+    {
+        for (size_t c = next++; c < chunks; c = next++)
+            fn(c, c * chunk, std::min(n, (c + 1) * chunk));
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool)
+        t.join();
+}
+
+// Lines per chunk when building outlines of a batch in parallel
+constexpr size_t kBuildChunk = 256;
+
+// Build the outlines of a batch of thick lines in parallel; the result is in input order and does
+// not depend on the number of threads (each line is computed on its own, chunks merge in order).
+// Only the geometry is touched, never the Fusion objects in the params.
+// lineEnds (optional) receives, per line, the number of outlines in out up to and including it.
+inline void buildBatchOutlines(const std::vector<ThickLineParams>& lines, std::vector<Outline>& out, unsigned threads,
+                               std::vector<size_t>* lineEnds = nullptr)
+{
+    std::vector<std::vector<Outline>> parts((lines.size() + kBuildChunk - 1) / kBuildChunk);
+    std::vector<size_t> counts(lineEnds ? lines.size() : 0);
+    parallelChunks(lines.size(), kBuildChunk, threads, [&](size_t c, size_t begin, size_t end)
+    {
+        parts[c].reserve((end - begin) * 3);
+        for (size_t i = begin; i < end; ++i) {
+            buildOutlines(lines[i], parts[c]);
+            if (lineEnds)
+                counts[i] = parts[c].size();
+        }
+    });
+
+    if (lineEnds) {
+        size_t before = out.size();
+        for (size_t c = 0; c < parts.size(); ++c) {
+            for (size_t i = c * kBuildChunk; i < std::min(lines.size(), (c + 1) * kBuildChunk); ++i)
+                lineEnds->push_back(before + counts[i]);
+            before += parts[c].size();
+        }
+    }
+
+    size_t total = out.size();
+    for (const auto& part : parts)
+        total += part.size();
+    out.reserve(total);
+    for (auto& part : parts)
+        out.insert(out.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+}
+
+// Point inside an outline (polygon by its corner points, even-odd; circles by radius)
+inline bool outlineContains(const Outline& o, const V2& p)
+{
+    if (o.circleR > 0 && !o.pts.empty())
+        return vlen(vsub(p, o.pts[0])) <= o.circleR;
+    bool in = false;
+    for (size_t i = 0, j = o.pts.size() - 1; i < o.pts.size(); j = i++) {
+        const V2& a = o.pts[i];
+        const V2& b = o.pts[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)
+            in = !in;
+    }
+    return in;
+}
+
+// Grow (d > 0) or shrink (d < 0) an outline by d, for kerf and etch compensation. Every edge
+// moves d along its outward normal and corners follow as mitres; fillets keep their centres, so
+// their radius changes by d. With round joins a sharp corner that the offset opens up (outer
+// corners when growing, inner ones when shrinking) gets an arc of radius |d|, the exact offset.
+// False when the outline vanishes (an edge turns around).
+inline bool offsetOutline(Outline& o, double d, bool roundJoins)
+{
+    if (d == 0)
+        return true;
+    if (o.circleR > 0) {
+        o.circleR += d;
+        return o.circleR > kEpsSketchLen;
+    }
+    const size_t n = o.pts.size();
+    const double area = n >= 3 ? outlineArea(o) : 0.0;
+    if (std::fabs(area) <= kEpsCoincident)
+        return false;
+    const double side = area > 0 ? 1.0 : -1.0; // counter-clockwise: outward is right of each edge
+
+    std::vector<V2> dir(n), nrm(n);
+    for (size_t i = 0; i < n; ++i) {
+        V2 e = vsub(o.pts[(i + 1) % n], o.pts[i]);
+        double len = vlen(e);
+        dir[i] = len > kEpsSketchLen ? vscale(e, 1.0 / len) : v2(0, 0);
+    }
+    for (size_t i = 0; i < n; ++i) // zero length edges take the direction of the one before
+        if (dir[i].x == 0 && dir[i].y == 0)
+            dir[i] = dir[(i + n - 1) % n];
+    for (size_t i = 0; i < n; ++i)
+        nrm[i] = vscale(v2(dir[i].y, -dir[i].x), side);
+
+    std::vector<V2> pts(n);
+    std::vector<double> fillet(n, 0.0);
+    bool anyFillet = false;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t ip = (i + n - 1) % n;
+        const V2 &n0 = nrm[ip], &n1 = nrm[i];
+        double denom = 1 + vdot(n0, n1);
+        pts[i] = denom > 1e-6 ? vadd(o.pts[i], vscale(vadd(n0, n1), d / denom)) : vadd(o.pts[i], vscale(n0, d));
+
+        const double r = i < o.fillet.size() ? o.fillet[i] : 0.0;
+        const double turn = side * vcross(dir[ip], dir[i]); // > 0: outer (convex) corner
+        const double grow = turn > 0 ? d : -d;              // what the corner radius gains
+        if (std::fabs(turn) > 1e-9 && (r > 0 || (roundJoins && grow > 0)))
+            fillet[i] = std::max(0.0, r + grow);
+        anyFillet = anyFillet || fillet[i] > 0;
+    }
+    for (size_t i = 0; i < n; ++i)
+        if (vdot(vsub(pts[(i + 1) % n], pts[i]), dir[i]) < -kEpsSketchLen)
+            return false;
+
+    o.pts.swap(pts);
+    if (anyFillet) {
+        o.fillet.swap(fillet);
+        o.isRect = false;
+    }
+    else
+        o.fillet.clear();
+    return true;
+}
+
+// Where compensated outlines go; each has its own offset
+enum class OutputTarget { Sketch = 0, Coverage, Export };
+
+inline double kerfFor(const ThickLineSettings& S, OutputTarget target)
+{
+    return target == OutputTarget::Sketch ? S.kerfSketch_cm : target == OutputTarget::Coverage ? S.kerfCoverage_cm : S.kerfExport_cm;
+}
+
+// Offset outlines by d; vanished ones become empty (indices stay). Returns how many vanished.
+inline size_t offsetOutlines(std::vector<Outline>& outlines, double d, bool roundJoins)
+{
+    size_t vanished = 0;
+    for (size_t i = 0; d != 0 && i < outlines.size(); ++i)
+        if (!outlines[i].pts.empty() && !offsetOutline(outlines[i], d, roundJoins)) {
+            outlines[i] = Outline();
+            vanished++;
+        }
+    return vanished;
+}
+
+// Apply the offset of a target to outlines (see offsetOutlines)
+inline size_t compensateOutlines(std::vector<Outline>& outlines, const ThickLineSettings& S, OutputTarget target)
+{
+    return offsetOutlines(outlines, kerfFor(S, target), S.kerfRoundJoins);
+}
+
+// Static R-tree over boxes, bulk loaded with Sort-Tile-Recursive packing: leaves hold up to
+// kFanout items that are close in x and y, and every level above packs the one below the same way.
+class OutlineRTree
+{
+public:
+    static constexpr size_t kFanout = 16;
+
+    void build(const std::vector<Box2>& boxes)
+    {
+        boxes_ = boxes;
+        nodes_.clear();
+        refs_.clear();
+        std::vector<Entry> level(boxes.size());
+        for (size_t i = 0; i < boxes.size(); ++i)
+            level[i] = { boxes[i], (uint32_t)i };
+        bool leaf = true;
+        while (!level.empty()) {
+            level = pack(level, leaf);
+            leaf = false;
+            if (level.size() == 1)
+                break;
+        }
+    }
+
+    size_t size() const { return boxes_.size(); }
+
+    // Calls fn(item) for every item whose box contains p
+    template <class Fn>
+    void query(const V2& p, Fn fn) const
+    {
+        visit([&p](const Box2& b) { return contains(b, p); }, fn);
+    }
+
+    // Calls fn(item) for every item whose box overlaps b
+    template <class Fn>
+    void query(const Box2& b, Fn fn) const
+    {
+        visit([&b](const Box2& n) { return n.overlaps(b); }, fn);
+    }
+
+private:
+    struct Entry { Box2 box; uint32_t ref; };
+    struct Node { Box2 box; uint32_t first, count; bool leaf; };
+
+    static bool contains(const Box2& b, const V2& p) { return p.x >= b.x0 && p.x <= b.x1 && p.y >= b.y0 && p.y <= b.y1; }
+
+    template <class Hit, class Fn>
+    void visit(Hit hit, Fn fn) const
+    {
+        if (nodes_.empty())
+            return;
+        std::vector<uint32_t> stack(1, (uint32_t)nodes_.size() - 1); // root is the last node
+        while (!stack.empty()) {
+            const Node& n = nodes_[stack.back()];
+            stack.pop_back();
+            if (!hit(n.box))
+                continue;
+            for (uint32_t k = n.first; k < n.first + n.count; ++k) {
+                if (!n.leaf)
+                    stack.push_back(refs_[k]);
+                else if (hit(boxes_[refs_[k]]))
+                    fn(refs_[k]);
+            }
+        }
+    }
+
+    // One STR level: vertical slices by x centre, each sorted by y centre and cut into nodes
+    std::vector<Entry> pack(std::vector<Entry>& in, bool leaf)
+    {
+        const size_t nodes = (in.size() + kFanout - 1) / kFanout;
+        const size_t slices = (size_t)std::ceil(std::sqrt((double)nodes));
+        const size_t perSlice = slices * kFanout;
+        auto cx = [](const Entry& e) { return e.box.x0 + e.box.x1; };
+        auto cy = [](const Entry& e) { return e.box.y0 + e.box.y1; };
+        std::sort(in.begin(), in.end(), [&](const Entry& a, const Entry& b) { return cx(a) < cx(b); });
+        std::vector<Entry> out;
+        out.reserve(nodes);
+        for (size_t s = 0; s < in.size(); s += perSlice) {
+            auto end = in.begin() + std::min(in.size(), s + perSlice);
+            std::sort(in.begin() + s, end, [&](const Entry& a, const Entry& b) { return cy(a) < cy(b); });
+            for (auto it = in.begin() + s; it < end; it += std::min<ptrdiff_t>(kFanout, end - it)) {
+                Node n{ Box2(), (uint32_t)refs_.size(), 0, leaf };
+                for (auto e = it; e < end && e < it + kFanout; ++e) {
+                    n.box.add(e->box);
+                    refs_.push_back(e->ref);
+                    n.count++;
+                }
+                out.push_back({ n.box, (uint32_t)nodes_.size() });
+                nodes_.push_back(n);
+            }
+        }
+        return out;
+    }
+
+    std::vector<Box2> boxes_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> refs_; // children: item ids in leaves, node ids above
+};
+
+// How outlines are turned into sketch entities
+struct EmitOptions {
+    EmitStrategy strategy = EmitStrategy::ThreePointRect;
+    bool deferFix = false; // fix all lines after the batch, with sketch compute deferred meanwhile
+};
+
+// Times one Fusion API call into a tally (no-op without tally)
+class ApiCallTimer
+{
+public:
+    ApiCallTimer(ApiCallTally* tally, ApiCall call)
+        : tally_(tally), call_((int)call), t0_(std::chrono::steady_clock::now()) {}
+    ~ApiCallTimer()
+    {
+        if (!tally_)
+            return;
+        tally_->calls[call_]++;
+        tally_->seconds[call_] += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0_).count();
+    }
+private:
+    ApiCallTally* tally_;
+    int call_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+// Number of API calls emitting the outlines would take (input for the cost model projection)
+inline ApiCallTally countEmitCalls(const std::vector<Outline>& outlines, const EmitOptions& opt)
+{
+    ApiCallTally t;
+    auto& calls = t.calls;
+    const int fix = (int)(opt.deferFix ? ApiCall::IsFixedDeferred : ApiCall::IsFixed);
+    std::vector<OutlineSeg> segs;
+    for (const Outline& o : outlines) {
+        if (o.circleR > 0) {
+            calls[fix] += 1;
+            calls[(int)ApiCall::Point3DCreate] += 1;
+            calls[(int)ApiCall::AddCircle] += 1;
+            continue;
+        }
+        if (o.isRect && opt.strategy == EmitStrategy::ThreePointRect) {
+            calls[fix] += 4;
+            calls[(int)ApiCall::Point3DCreate] += 3;
+            calls[(int)ApiCall::AddThreePointRectangle] += 1;
+            continue;
+        }
+        outlineSegments(o, segs);
+        size_t n = segs.size();
+        size_t arcs = (size_t)std::count_if(segs.begin(), segs.end(), [](const OutlineSeg& g) { return g.arc; });
+        calls[fix] += n;
+        calls[(int)ApiCall::AddByTwoPoints] += n - arcs;
+        calls[(int)ApiCall::AddArcByThreePoints] += arcs;
+        // shared points: first edge creates 2 points, middle edges 1, the closing edge none; arcs add their mid point
+        calls[(int)ApiCall::Point3DCreate] += (opt.strategy == EmitStrategy::SharedPoints ? n : 2 * n) + arcs;
+    }
+    return t;
+}
+
+// Creates sketch entities for outlines with a given strategy, timing every API call
+class SketchEmitter
+{
+public:
+    SketchEmitter(const Ptr<Sketch>& sk, const EmitOptions& opt, ApiCallTally* tally = nullptr)
+        : sk_(sk), opt_(opt), tally_(tally)
+    {
+        if (!sk_)
+            return;
+        lines_ = sk_->sketchCurves()->sketchLines();
+        arcs_ = sk_->sketchCurves()->sketchArcs();
+        circles_ = sk_->sketchCurves()->sketchCircles();
+        if (opt_.deferFix) {
+            wasDeferred_ = sk_->isComputeDeferred();
+            sk_->isComputeDeferred(true);
+        }
+    }
+
+    ~SketchEmitter() { finish(); }
+
+    void emit(const Outline& o)
+    {
+        if (!lines_)
+            return;
+        if (o.circleR > 0 && !o.pts.empty())
+            emitCircle(o);
+        else if (o.pts.size() < 3)
+            return;
+        else if (o.isRect && opt_.strategy == EmitStrategy::ThreePointRect)
+            emitRect(o);
+        else {
+            outlineSegments(o, segs_);
+            emitSegments(segs_, opt_.strategy == EmitStrategy::SharedPoints);
+        }
+    }
+
+    // Fix deferred lines and restore sketch compute
+    void finish()
+    {
+        if (finished_ || !sk_)
+            return;
+        finished_ = true;
+        if (!opt_.deferFix)
+            return;
+        for (const Ptr<SketchCurve>& l : pendingFix_) {
+            ApiCallTimer t(tally_, ApiCall::IsFixedDeferred);
+            l->isFixed(true);
+        }
+        pendingFix_.clear();
+        sk_->isComputeDeferred(wasDeferred_);
+    }
+
+    const std::vector<Ptr<SketchCurve>>& created() const { return created_; }
+
+private:
+    Ptr<Point3D> point(const V2& p)
+    {
+        ApiCallTimer t(tally_, ApiCall::Point3DCreate);
+        return P2(p);
+    }
+
+    void fix(const Ptr<SketchCurve>& l)
+    {
+        created_.push_back(l);
+        if (opt_.deferFix) {
+            pendingFix_.push_back(l);
+            return;
+        }
+        ApiCallTimer t(tally_, ApiCall::IsFixed);
+        l->isFixed(true);
+    }
+
+    void emitCircle(const Outline& o)
+    {
+        Ptr<Point3D> c = point(o.pts[0]);
+        Ptr<SketchCircle> circle;
+        {
+            ApiCallTimer t(tally_, ApiCall::AddCircle);
+            circle = circles_->addByCenterRadius(c, o.circleR);
+        }
+        if (circle)
+            fix(circle);
+    }
+
+    void emitRect(const Outline& o)
+    {
+        Ptr<Point3D> p0 = point(o.pts[0]);
+        Ptr<Point3D> p1 = point(o.pts[1]);
+        Ptr<Point3D> p3 = point(o.pts[3]);
+        Ptr<SketchLineList> rect;
+        {
+            ApiCallTimer t(tally_, ApiCall::AddThreePointRectangle);
+            rect = lines_->addThreePointRectangle(p0, p1, p3);
+        }
+        if (!rect)
+            return;
+        for (size_t i = 0; i < rect->count(); ++i)
+            fix(rect->item(i));
+    }
+
+    // The sketch point of a new arc that lies at p (Fusion orders arc end points counter-clockwise)
+    static Ptr<SketchPoint> arcPointAt(const Ptr<SketchArc>& arc, const V2& p)
+    {
+        Ptr<SketchPoint> s = arc->startSketchPoint();
+        Ptr<SketchPoint> e = arc->endSketchPoint();
+        Ptr<Point3D> sg = s->geometry();
+        Ptr<Point3D> eg = e->geometry();
+        double ds = vlen(vsub(v2(sg->x(), sg->y()), p));
+        double de = vlen(vsub(v2(eg->x(), eg->y()), p));
+        return ds < de ? s : e;
+    }
+
+    void emitSegments(const std::vector<OutlineSeg>& segs, bool sharePoints)
+    {
+        const size_t n = segs.size();
+        Ptr<SketchPoint> firstStart, prevEnd;
+        for (size_t i = 0; i < n; ++i) {
+            const OutlineSeg& g = segs[i];
+            Ptr<Base> pa, pb;
+            if (sharePoints && prevEnd)
+                pa = prevEnd;
+            else
+                pa = point(g.a);
+            if (sharePoints && firstStart && i + 1 == n)
+                pb = firstStart;
+            else
+                pb = point(g.b);
+
+            Ptr<SketchCurve> c;
+            Ptr<SketchPoint> start, end;
+            if (g.arc) {
+                Ptr<Point3D> pm = point(g.mid);
+                Ptr<SketchArc> arc;
+                {
+                    ApiCallTimer t(tally_, ApiCall::AddArcByThreePoints);
+                    arc = arcs_->addByThreePoints(pa, pm, pb);
+                }
+                if (!arc)
+                    return;
+                c = arc;
+                if (sharePoints) {
+                    start = arcPointAt(arc, g.a);
+                    end = arcPointAt(arc, g.b);
+                }
+            }
+            else {
+                Ptr<SketchLine> l;
+                {
+                    ApiCallTimer t(tally_, ApiCall::AddByTwoPoints);
+                    l = lines_->addByTwoPoints(pa, pb);
+                }
+                if (!l)
+                    return;
+                c = l;
+                if (sharePoints) {
+                    start = l->startSketchPoint();
+                    end = l->endSketchPoint();
+                }
+            }
+            fix(c);
+            if (!firstStart) firstStart = start;
+            prevEnd = end;
+        }
+    }
+
+    Ptr<Sketch> sk_;
+    Ptr<SketchLines> lines_;
+    Ptr<SketchArcs> arcs_;
+    Ptr<SketchCircles> circles_;
+    EmitOptions opt_;
+    ApiCallTally* tally_;
+    bool wasDeferred_ = false;
+    bool finished_ = false;
+    std::vector<Ptr<SketchCurve>> pendingFix_;
+    std::vector<Ptr<SketchCurve>> created_;
+    std::vector<OutlineSeg> segs_;
+};
+
+// Outlines per strategy trial when tuning, and the minimum batch size (in trial rounds) worth tuning
+constexpr size_t kTuneChunk = 16;
+constexpr size_t kTuneMinRounds = 4;
+
+// Emit a batch of outlines. Large batches first emit one chunk with every strategy, then continue
+// with the fastest one (time per created curve, including the sketch compute of the chunk) and
+// remember it for the sketch size bucket. Smaller batches use the remembered strategy, or the
+// configured one when the bucket was never tuned. When the caller already deferred the compute,
+// the trials cannot include it and only time the creation calls.
+// curveEnds (optional) receives, per outline, the number of curves created up to and including it
+inline std::vector<Ptr<SketchCurve>> emitBatch(const Ptr<Sketch>& sk, const std::vector<Outline>& input, ThickLineSettings& S,
+                                               std::vector<size_t>* curveEnds = nullptr)
+{
+    std::vector<Ptr<SketchCurve>> created;
+    if (!sk || input.empty())
+        return created;
+
+    // kerf / etch compensation of the sketch output
+    std::vector<Outline> compensated;
+    if (kerfFor(S, OutputTarget::Sketch) != 0) {
+        compensated = input;
+        if (size_t vanished = compensateOutlines(compensated, S, OutputTarget::Sketch))
+            LogFusion("[ThickLine] Compensation removed " + std::to_string(vanished) + " outline(s) smaller than the offset.");
+    }
+    const std::vector<Outline>& outlines = compensated.empty() ? input : compensated;
+
+    const int bucket = sketchSizeBucket(sk->sketchCurves()->count());
+    EmitStrategy strategy = S.tunedSet[bucket] ? S.tuned[bucket] : S.emitStrategy;
+
+    // the whole batch is one deferred sketch compute
+    const bool wasDeferred = sk->isComputeDeferred();
+    if (!wasDeferred)
+        sk->isComputeDeferred(true);
+    ApiCallTally tally;
+    size_t next = 0;
+
+    auto emitRange = [&](EmitStrategy st, size_t from, size_t to)
+    {
+        SketchEmitter emitter(sk, EmitOptions{ st, S.emitDeferFix }, &tally);
+        for (size_t i = from; i < to; ++i) {
+            emitter.emit(outlines[i]);
+            if (curveEnds)
+                curveEnds->push_back(created.size() + emitter.created().size());
+        }
+        emitter.finish();
+        created.insert(created.end(), emitter.created().begin(), emitter.created().end());
+    };
+
+    const size_t strategies = (size_t)EmitStrategy::Count;
+    if (S.emitAutoTune && outlines.size() >= kTuneChunk * strategies * kTuneMinRounds)
+    {
+        double best = 0;
+        bool timed = false;
+        for (size_t s = 0; s < strategies; ++s)
+        {
+            size_t curves = 0;
+            for (size_t i = next; i < next + kTuneChunk; ++i)
+                curves += outlineCurveCount(outlines[i]);
+
+            auto t0 = std::chrono::steady_clock::now();
+            emitRange((EmitStrategy)s, next, next + kTuneChunk);
+            if (!wasDeferred) { // solve the chunk now, inside the timing
+                sk->isComputeDeferred(false);
+                sk->isComputeDeferred(true);
+            }
+            double perCurve = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / (double)std::max<size_t>(curves, 1);
+            next += kTuneChunk;
+
+            if (curves == 0) // nothing was emitted (all outlines vanished by compensation)
+                continue;
+            if (!timed || perCurve < best) {
+                best = perCurve;
+                strategy = (EmitStrategy)s;
+                timed = true;
+            }
+        }
+        if (timed) {
+            S.tuned[bucket] = strategy;
+            S.tunedSet[bucket] = true;
+            LogFusion(std::string("[ThickLine] Emit strategy for sketch size bucket ") + std::to_string(bucket) + ": " + emitStrategyName(strategy));
+        }
+    }
+
+    emitRange(strategy, next, outlines.size());
+    if (!wasDeferred)
+        sk->isComputeDeferred(false);
+    S.cost.observe(bucket, tally);
+    return created;
+}
+
+// Everything one run of the command creates
+struct ThickLineJob {
+    std::string mode = "Single";          // "Single", "Hub", "Sweep" or "Chain"
+    ThickLineParams style;                // sizes and features as entered
+    SweepSpec sweep;                      // ranges (sweep mode)
+    std::vector<V2> points;               // A (or the hub) first, then every B (sketch space)
+    std::vector<std::string> labels;      // per line (sweep mode)
+    std::vector<ThickLineParams> lines;
+    std::vector<Outline> shared;          // outlines belonging to several lines (hub junction or pad)
+    double kerfCm = 0;                    // compensation its curves were emitted with (recorded)
+    bool kerfRoundJoins = true;
+};
+
+// Build and validate the lines (and shared outlines) of a job from its mode, style and points
+bool buildJobLines(ThickLineJob& job, std::string& err)
+{
+    job.lines.clear();
+    job.shared.clear();
+    if (job.points.size() < 2)
+    {
+        err = "Select point or entity for A and B.";
+        return false;
+    }
+
+    if (job.mode == "Single" || job.mode == "Sweep")
+    {
+        ThickLineParams P = job.style;
+        P.A = job.points[0];
+        P.B = job.points[1];
+        if (!computeDerived(P, err))
+            return false;
+        if (P.featAType == "Pad")
+        {
+            err = "A pad is only available at the hub in Hub and spokes mode.";
+            return false;
+        }
+        job.style = P;
+        if (job.mode == "Sweep")
+        {
+            job.labels.clear();
+            return buildSweep(P, job.sweep, job.lines, job.labels, err);
+        }
+        if (!validateParams(P, err))
+            return false;
+        job.lines.assign(1, P);
+        return true;
+    }
+
+    // Chain: A, then every B in order, as one merged route outline
+    if (job.mode == "Chain")
+        return buildChain(job.style, job.points, job.shared, err);
+
+    // Hub and spokes: A is the hub, every B a spoke end
+    if (job.style.widthCm <= 0)
+    {
+        err = "Width of line must be > 0.";
+        return false;
+    }
+    if (job.style.featAType != "None" && job.style.featAType != "Pad")
+    {
+        err = "Feature A must be None or Pad in Hub and spokes mode.";
+        return false;
+    }
+    double pad = job.style.featAType == "Pad" ? job.style.featAWCm : 0.0;
+    if (pad > 0 && pad < job.style.widthCm)
+    {
+        err = "Pad diameter must be >= line width.";
+        return false;
+    }
+    std::vector<V2> ends(job.points.begin() + 1, job.points.end());
+    return buildHub(job.style, job.points[0], ends, pad, job.lines, job.shared, err);
+}
+
+// Extract and validate the job described by the command inputs
+bool buildJob(const Ptr<CommandInputs>& inputs, ThickLineJob& job, std::string& err)
+{
+    Ptr<DropDownCommandInput> modeIn = inputs->itemById(kModeId)->cast<DropDownCommandInput>();
+    int modeIndex = (modeIn && modeIn->selectedItem()) ? modeIn->selectedItem()->index() : 0;
+    job.mode = modeIndex == 1 ? "Hub" : modeIndex == 2 ? "Sweep" : modeIndex == 3 ? "Chain" : "Single";
+
+    if (job.mode != "Hub" && job.mode != "Chain")
+    {
+        if (!extractParams(inputs, job.style, err))
+            return false;
+        job.points = { job.style.A, job.style.B };
+        if (job.mode == "Sweep")
+        {
+            job.sweep = loadSettingsIni().sweep; // while the group is not built
+            for (int p = 0; p < kSweepParams; ++p)
+            {
+                Ptr<ValueCommandInput> to = inputById<ValueCommandInput>(inputs, kSweepToPrefix + std::string(sweepParamKey(p)));
+                Ptr<IntegerSpinnerCommandInput> steps = inputById<IntegerSpinnerCommandInput>(inputs, kSweepStepsPrefix + std::string(sweepParamKey(p)));
+                if (to)
+                    job.sweep.to[p] = to->value();
+                if (steps)
+                    job.sweep.steps[p] = steps->value();
+            }
+            Ptr<ValueCommandInput> gap = inputById<ValueCommandInput>(inputs, kSweepGapId);
+            if (gap)
+                job.sweep.gapCm = gap->value();
+        }
+        return buildJobLines(job, err);
+    }
+
+    if (!extractStyle(inputs, job.style, err))
+        return false;
+    Ptr<SelectionCommandInput> selA = inputs->itemById(kSelPointAId)->cast<SelectionCommandInput>();
+    Ptr<SelectionCommandInput> selB = inputs->itemById(kSelPointBId)->cast<SelectionCommandInput>();
+    job.points.assign(1, V2{});
+    if (!selA || selA->selectionCount() == 0 || !selectionPoint(selA, 0, job.style.sketch, job.points[0]))
+    {
+        err = job.mode == "Chain" ? "Select the start point (A)." : "Select the hub point (A).";
+        return false;
+    }
+    if (!selB || selB->selectionCount() == 0)
+    {
+        err = job.mode == "Chain" ? "Select the chain points (B), in order." : "Select one or more spoke end points (B).";
+        return false;
+    }
+    job.points.resize(1 + selB->selectionCount());
+    for (size_t i = 0; i < selB->selectionCount(); ++i)
+        if (!selectionPoint(selB, i, job.style.sketch, job.points[1 + i]))
+        {
+            err = "Could not read geometry for " + std::string(job.mode == "Chain" ? "chain point " : "spoke end ") + std::to_string(i + 1) + ".";
+            return false;
+        }
+    return buildJobLines(job, err);
+}
+
+// ---- Hit-test index of the thick lines in a sketch ----
+// Outlines regenerated from the sketch's records, in an R-tree, so a click resolves to its record
+// in logarithmic time. The curves of every record are collected once, while building.
+// Indexes are kept per sketch between commands and follow the records this add-in writes or
+// removes: new outlines go to an overflow list that is scanned linearly, removed records are
+// tombstoned, and both are folded into a fresh tree once they make up a good part of it.
+// Edits made elsewhere (other commands, scripts, undo / redo) are caught by checking the sketch
+// against the revision the index was made for whenever the index is used.
+
+// What a cached index is checked against: the counts of the sketch's curves and attributes (its
+// records), the next record id and the newest curve. Adding or removing thick lines, by any means,
+// changes at least one of them; edits that keep them all (moving curves, say) leave the records,
+// which the index is built from, as they were.
+struct SketchRevision {
+    size_t curves = 0;
+    size_t attributes = 0;
+    std::string nextJob;
+    std::string lastCurve; // entity token (compared through the entity it resolves to)
+};
+
+struct SketchIndex {
+    std::string sketchToken;                             // as last seen (tokens of one sketch may differ)
+    SketchRevision revision;                             // sketch state the index matches
+    uint64_t lastUse = 0;                                // for evicting the least recently used
+    std::vector<std::string> records;                    // record ids
+    std::vector<std::vector<Ptr<SketchCurve>>> curves;   // per record
+    std::vector<char> dead;                              // per record: removed since the build
+    std::vector<uint32_t> outlineCount;                  // per record
+    std::unordered_map<std::string, uint32_t> recordOf;  // record id -> index
+    std::vector<Outline> outlines;
+    std::vector<uint32_t> outlineRecord;                 // per outline
+    OutlineRTree tree;                                   // outlines [0, tree.size())
+    size_t deadOutlines = 0;
+
+    // Record under a sketch point (the smallest outline wins), -1 = none
+    int hit(const V2& p) const
+    {
+        int best = -1;
+        double bestArea = 0;
+        auto test = [&](uint32_t i) {
+            if (dead[outlineRecord[i]] || !outlineContains(outlines[i], p))
+                return;
+            double a = outlineArea(outlines[i]);
+            if (best < 0 || a < bestArea) {
+                best = (int)outlineRecord[i];
+                bestArea = a;
+            }
+        };
+        tree.query(p, test);
+        for (size_t i = tree.size(); i < outlines.size(); ++i) // overflow
+            test((uint32_t)i);
+        return best;
+    }
+
+    // Add a record with its outlines and curves (replaces a record of the same id)
+    void add(const std::string& id, const std::vector<Outline>& recOutlines, std::vector<Ptr<SketchCurve>> recCurves)
+    {
+        remove(id);
+        uint32_t rec = (uint32_t)records.size();
+        records.push_back(id);
+        curves.push_back(std::move(recCurves));
+        dead.push_back(0);
+        outlineCount.push_back((uint32_t)recOutlines.size());
+        recordOf[id] = rec;
+        outlines.insert(outlines.end(), recOutlines.begin(), recOutlines.end());
+        outlineRecord.insert(outlineRecord.end(), recOutlines.size(), rec);
+        if (outlines.size() - tree.size() > std::max<size_t>(64, tree.size() / 4))
+            compact();
+    }
+
+    void remove(const std::string& id)
+    {
+        auto it = recordOf.find(id);
+        if (it == recordOf.end())
+            return;
+        dead[it->second] = 1;
+        deadOutlines += outlineCount[it->second];
+        recordOf.erase(it);
+        if (deadOutlines > std::max<size_t>(64, outlines.size() / 4))
+            compact();
+    }
+
+    // Drop tombstoned records and rebuild the tree over all outlines
+    void compact()
+    {
+        std::vector<uint32_t> newIndex(records.size(), UINT32_MAX);
+        size_t r = 0;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (dead[i])
+                continue;
+            newIndex[i] = (uint32_t)r;
+            if (r != i) {
+                records[r] = std::move(records[i]);
+                curves[r] = std::move(curves[i]);
+                outlineCount[r] = outlineCount[i];
+            }
+            recordOf[records[r]] = (uint32_t)r;
+            ++r;
+        }
+        records.resize(r);
+        curves.resize(r);
+        outlineCount.resize(r);
+        dead.assign(r, 0);
+
+        size_t o = 0;
+        for (size_t i = 0; i < outlines.size(); ++i) {
+            if (newIndex[outlineRecord[i]] == UINT32_MAX)
+                continue;
+            if (o != i)
+                outlines[o] = std::move(outlines[i]);
+            outlineRecord[o++] = newIndex[outlineRecord[i]];
+        }
+        outlines.resize(o);
+        outlineRecord.resize(o);
+        deadOutlines = 0;
+
+        std::vector<Box2> boxes(outlines.size());
+        for (size_t i = 0; i < boxes.size(); ++i)
+            boxes[i] = outlineBox(outlines[i]);
+        tree.build(boxes);
+    }
+};
+
+// Indexes by the sketch token they were last found under; at most kMaxSketchIndexes are kept
+constexpr size_t kMaxSketchIndexes = 4;
+static std::unordered_map<std::string, SketchIndex> g_SketchIndexes;
+static uint64_t g_SketchIndexClock = 0;
+
+// ---- Parameter records and copy / paste ----
+// Every run of the command stores its parameters as an attribute on the sketch ("job<id>"), and
+// every curve it creates carries the id. Copy collects the records of the selected curves into
+// an in-memory clipboard (points in sketch space, with the sketch's world frame); paste
+// regenerates them in the active sketch as one batch, which is much cheaper than pasting the
+// constrained geometry.
+
+static const char* kAttrGroup = "habiThickLine";
+static const char* kAttrJobId = "job";        // on curves: id of the record that created them
+static const char* kAttrNextJob = "nextJob";  // on the sketch: next free record id
+
+// Entities an entity token stands for (none when they are gone)
+inline std::vector<Ptr<Base>> entitiesByToken(const std::string& token)
+{
+    Ptr<Design> design = _app ? _app->activeProduct()->cast<Design>() : nullptr;
+    return design && !token.empty() ? design->findEntityByToken(token) : std::vector<Ptr<Base>>();
+}
+
+// True when token stands for entity e. Tokens of one entity may differ between calls, so unequal
+// strings are resolved and the entities compared.
+inline bool sameEntity(const std::string& token, const Ptr<Base>& e)
+{
+    if (!e)
+        return token.empty();
+    Ptr<SketchEntity> se = e->cast<SketchEntity>();
+    Ptr<Sketch> sk = e->cast<Sketch>();
+    const std::string mine = se ? se->entityToken() : sk ? sk->entityToken() : std::string();
+    if (!mine.empty() && mine == token)
+        return true;
+    for (const Ptr<Base>& f : entitiesByToken(token))
+        if (f == e)
+            return true;
+    return false;
+}
+
+// Current revision of a sketch (see SketchRevision)
+inline SketchRevision sketchRevision(const Ptr<Sketch>& sk)
+{
+    SketchRevision r;
+    Ptr<SketchCurves> curves = sk ? sk->sketchCurves() : nullptr;
+    Ptr<Attributes> attrs = sk ? sk->attributes() : nullptr;
+    r.curves = curves ? curves->count() : 0;
+    Ptr<SketchCurve> last = r.curves ? curves->item(r.curves - 1) : nullptr;
+    r.lastCurve = last ? last->entityToken() : std::string();
+    r.attributes = attrs ? attrs->count() : 0;
+    Ptr<Attribute> next = attrs ? attrs->itemByName(kAttrGroup, kAttrNextJob) : nullptr;
+    r.nextJob = next ? next->value() : std::string();
+    return r;
+}
+
+// True when a sketch still is at revision r
+inline bool sketchAtRevision(const Ptr<Sketch>& sk, const SketchRevision& r)
+{
+    Ptr<SketchCurves> curves = sk ? sk->sketchCurves() : nullptr;
+    Ptr<Attributes> attrs = sk ? sk->attributes() : nullptr;
+    const size_t count = curves ? curves->count() : 0;
+    if (count != r.curves || (attrs ? attrs->count() : 0) != r.attributes)
+        return false;
+    Ptr<Attribute> next = attrs ? attrs->itemByName(kAttrGroup, kAttrNextJob) : nullptr;
+    if ((next ? next->value() : std::string()) != r.nextJob)
+        return false;
+    return sameEntity(r.lastCurve, count ? curves->item(count - 1) : nullptr);
+}
+
+// Cached index of a sketch, nullptr when there is none or the sketch changed since (then dropped).
+// Code that edits the sketch looks the index up before its edits, keeps it current, and stamps it
+// with the new revision after them. A sketch found under a new token takes its entry along;
+// entries of sketches that are gone are dropped on the way.
+inline SketchIndex* cachedSketchIndex(const Ptr<Sketch>& sk)
+{
+    if (!sk)
+        return nullptr;
+    const std::string token = sk->entityToken();
+    auto it = g_SketchIndexes.find(token);
+    for (auto e = g_SketchIndexes.begin(); it == g_SketchIndexes.end() && e != g_SketchIndexes.end();) {
+        std::vector<Ptr<Base>> found = entitiesByToken(e->first);
+        if (found.empty()) {
+            e = g_SketchIndexes.erase(e);
+            continue;
+        }
+        if (std::find(found.begin(), found.end(), Ptr<Base>(sk)) == found.end()) {
+            ++e;
+            continue;
+        }
+        auto node = g_SketchIndexes.extract(e); // the entry stays where it is
+        node.key() = token;
+        node.mapped().sketchToken = token;
+        it = g_SketchIndexes.insert(std::move(node)).position;
+    }
+    if (it == g_SketchIndexes.end())
+        return nullptr;
+    if (!sketchAtRevision(sk, it->second.revision)) {
+        g_SketchIndexes.erase(it);
+        return nullptr;
+    }
+    it->second.lastUse = ++g_SketchIndexClock;
+    return &it->second;
+}
+
+// A copied record (as stored on its sketch) and the sketch -> world transform it came with
+struct ClipRecord {
+    std::string record;
+    std::vector<double> frame; // row-major 4x4
+};
+static std::vector<ClipRecord> g_Clipboard;
+
+// Serialize mode, style, compensation and points of a job; coords holds dims (2 or 3) values per
+// point. TL2 records add the compensation to TL1 (which had none).
+inline std::string encodeJobRecord(const ThickLineJob& job, const std::vector<double>& coords, int dims)
+{
+    const ThickLineParams& P = job.style;
+    std::ostringstream s;
+    s << std::setprecision(17);
+    s << "TL2;" << job.mode << ";" << dims << ";"
+      << P.widthCm << ";" << P.leadACm << ";" << P.leadBCm << ";" << P.capFilletCm << ";"
+      << P.markerSpacingCm << ";" << P.markerWCm << ";" << P.markerLCm << ";"
+      << P.featAType << ";" << P.featAWCm << ";" << P.featALCm << ";"
+      << P.featBType << ";" << P.featBWCm << ";" << P.featBLCm << ";"
+      << job.kerfCm << ";" << (job.kerfRoundJoins ? 1 : 0) << ";"
+      << coords.size() / dims;
+    for (double c : coords)
+        s << ";" << c;
+    return s.str();
+}
+
+inline bool decodeJobRecord(const std::string& rec, ThickLineJob& job, std::vector<double>& coords, int& dims, std::string& err)
+{
+    std::vector<std::string> f;
+    size_t start = 0;
+    for (;;) {
+        size_t end = rec.find(';', start);
+        f.push_back(rec.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos)
+            break;
+        start = end + 1;
+    }
+    err = "Damaged Thick Line record.";
+    if (f.size() < 17 || (f[0] != "TL1" && f[0] != "TL2"))
+        return false;
+    const size_t head = f[0] == "TL2" ? 19 : 17; // fields before the coordinates
+    if (f.size() < head)
+        return false;
+
+    bool ok = true;
+    auto num = [&ok](const std::string& t) {
+        char* end = nullptr;
+        double v = std::strtod(t.c_str(), &end);
+        if (t.empty() || *end != '\0')
+            ok = false;
+        return v;
+    };
+    // whole number in [0, hi], checked before it is converted (the text may be anything)
+    auto whole = [&num, &ok](const std::string& t, double hi) -> size_t {
+        double v = num(t);
+        if (!std::isfinite(v) || v != std::floor(v) || v < 0 || v > hi) {
+            ok = false;
+            return 0;
+        }
+        return (size_t)v;
+    };
+    ThickLineParams& P = job.style;
+    job.mode = f[1];
+    dims = (int)whole(f[2], 3);
+    P.widthCm = num(f[3]);
+    P.leadACm = num(f[4]);
+    P.leadBCm = num(f[5]);
+    P.capFilletCm = num(f[6]);
+    P.markerSpacingCm = num(f[7]);
+    P.markerWCm = num(f[8]);
+    P.markerLCm = num(f[9]);
+    P.featAType = f[10];
+    P.featAWCm = num(f[11]);
+    P.featALCm = num(f[12]);
+    P.featBType = f[13];
+    P.featBWCm = num(f[14]);
+    P.featBLCm = num(f[15]);
+    job.kerfCm = head == 19 ? num(f[16]) : 0;
+    job.kerfRoundJoins = head == 19 ? num(f[17]) != 0 : true;
+    const size_t n = whole(f[head - 1], (double)((f.size() - head) / 2)); // 2 values per point at least
+    if (!ok || (dims != 2 && dims != 3) || n < 2 || f.size() != head + n * dims)
+        return false;
+
+    coords.resize(n * dims);
+    for (size_t i = 0; i < coords.size(); ++i)
+        coords[i] = num(f[head + i]);
+    if (!ok)
+        return false;
+    err.clear();
+    return true;
+}
+
+// Store the record of a job on its sketch and tag the curves it created. index (optional) is the
+// sketch's cached index, looked up before the curves were emitted; the record is added to it.
+inline void recordJob(const ThickLineJob& job, const std::vector<Ptr<SketchCurve>>& curves, size_t from, size_t to,
+                      SketchIndex* index = nullptr)
+{
+    Ptr<Sketch> sk = job.style.sketch;
+    Ptr<Attributes> attrs = sk ? sk->attributes() : nullptr;
+    if (!attrs)
+        return;
+
+    std::vector<double> coords;
+    coords.reserve(job.points.size() * 2);
+    for (const V2& p : job.points) {
+        coords.push_back(p.x);
+        coords.push_back(p.y);
+    }
+
+    Ptr<Attribute> next = attrs->itemByName(kAttrGroup, kAttrNextJob);
+    long id = next ? std::atol(next->value().c_str()) : 0;
+    std::string idStr = std::to_string(id);
+    if (next)
+        next->value(std::to_string(id + 1));
+    else
+        attrs->add(kAttrGroup, kAttrNextJob, std::to_string(id + 1));
+    attrs->add(kAttrGroup, kAttrJobId + idStr, encodeJobRecord(job, coords, 2));
+
+    for (size_t i = from; i < to && i < curves.size(); ++i) {
+        Ptr<Attributes> ca = curves[i] ? curves[i]->attributes() : nullptr;
+        if (ca)
+            ca->add(kAttrGroup, kAttrJobId, idStr);
+    }
+
+    // keep a cached index of the sketch current
+    if (index) {
+        std::vector<Outline> outlines;
+        for (const ThickLineParams& P : job.lines)
+            buildOutlines(P, outlines);
+        outlines.insert(outlines.end(), job.shared.begin(), job.shared.end());
+        to = std::min(to, curves.size());
+        index->add(idStr, outlines, std::vector<Ptr<SketchCurve>>(curves.begin() + std::min(from, to), curves.begin() + to));
+    }
+}
+
+// Build the lines of jobs (points in sk's space) and emit all of them as one batch, each with its
+// record. Invalid jobs are skipped and counted; the first reason is logged. Returns the jobs made.
+// created / bounds (optional) receive the created curves and the box around their outlines.
+inline size_t regenerateJobs(const Ptr<Sketch>& sk, std::vector<ThickLineJob>& jobs, ThickLineSettings& S,
+                             const std::string& what, size_t& invalid,
+                             std::vector<Ptr<SketchCurve>>* createdOut = nullptr, Box2* bounds = nullptr)
+{
+    invalid = 0;
+    std::vector<ThickLineJob> valid;
+    valid.reserve(jobs.size());
+    std::vector<ThickLineParams> lines;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        ThickLineJob& job = jobs[j];
+        job.style.sketch = sk;
+        std::string err;
+        if (!buildJobLines(job, err)) {
+            if (invalid++ == 0)
+                LogFusion("[ThickLine] " + what + ": skipped item " + std::to_string(j + 1) + ": " + err);
+            continue;
+        }
+        lines.insert(lines.end(), job.lines.begin(), job.lines.end());
+        valid.push_back(std::move(job));
+    }
+    jobs.swap(valid);
+
+    // outlines of all lines in parallel, then regrouped per job (its lines, then its shared outlines)
+    std::vector<Outline> lineOutlines, outlines;
+    std::vector<size_t> lineEnds, firstOutline;
+    buildBatchOutlines(lines, lineOutlines, S.workerThreads, &lineEnds);
+    outlines.reserve(lineOutlines.size());
+    size_t line = 0;
+    for (const ThickLineJob& job : jobs) {
+        firstOutline.push_back(outlines.size());
+        size_t from = line == 0 ? 0 : lineEnds[line - 1];
+        line += job.lines.size();
+        size_t to = line == 0 ? 0 : lineEnds[line - 1];
+        outlines.insert(outlines.end(), std::make_move_iterator(lineOutlines.begin() + from), std::make_move_iterator(lineOutlines.begin() + to));
+        outlines.insert(outlines.end(), job.shared.begin(), job.shared.end());
+    }
+    firstOutline.push_back(outlines.size());
+
+    // one batch for everything, then split the curves per job for the records
+    SketchIndex* index = cachedSketchIndex(sk);
+    std::vector<size_t> curveEnds;
+    std::vector<Ptr<SketchCurve>> created = emitBatch(sk, outlines, S, &curveEnds);
+    auto curvesBefore = [&curveEnds](size_t outline) { return outline == 0 ? 0 : curveEnds[outline - 1]; };
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        jobs[j].kerfCm = kerfFor(S, OutputTarget::Sketch); // as emitBatch applied it
+        jobs[j].kerfRoundJoins = S.kerfRoundJoins;
+        recordJob(jobs[j], created, curvesBefore(firstOutline[j]), curvesBefore(firstOutline[j + 1]), index);
+    }
+    if (index)
+        index->revision = sketchRevision(sk);
+    if (bounds)
+        for (const Outline& o : outlines)
+            bounds->add(outlineBox(o));
+    if (createdOut)
+        createdOut->swap(created);
+    return jobs.size();
+}
+
+// ---- Profiles of created geometry ----
+
+// Profiles made only of the given curves (typically the ones a batch just created). The API has
+// no way from a curve to its profiles, so this scans every profile of the sketch: one bounding
+// box read each (three API calls), which is O(sketch). Only profiles inside the batch bounds go
+// on to the loop walk, checked against a token set of the created curves, so the per-curve cost
+// stays with the batch.
+inline std::vector<Ptr<Profile>> profilesOfCurves(const Ptr<Sketch>& sk, const std::vector<Ptr<SketchCurve>>& curves, const Box2& bounds)
+{
+    std::vector<Ptr<Profile>> found;
+    Ptr<Profiles> profiles = sk ? sk->profiles() : nullptr;
+    if (!profiles || curves.empty() || bounds.empty())
+        return found;
+
+    std::unordered_set<std::string> tokens;
+    tokens.reserve(curves.size());
+    for (const Ptr<SketchCurve>& c : curves)
+        if (c)
+            tokens.insert(c->entityToken());
+
+    const double tol = 1e-6;
+    for (size_t i = 0; i < profiles->count(); ++i) {
+        Ptr<Profile> prof = profiles->item(i);
+        Ptr<BoundingBox3D> bb = prof ? prof->boundingBox() : nullptr; // sketch space
+        if (!bb)
+            continue;
+        Ptr<Point3D> lo = bb->minPoint(), hi = bb->maxPoint();
+        if (lo->x() < bounds.x0 - tol || lo->y() < bounds.y0 - tol || hi->x() > bounds.x1 + tol || hi->y() > bounds.y1 + tol)
+            continue;
+
+        bool ours = true;
+        Ptr<ProfileLoops> loops = prof->profileLoops();
+        for (size_t l = 0; ours && loops && l < loops->count(); ++l) {
+            Ptr<ProfileCurves> pcs = loops->item(l)->profileCurves();
+            for (size_t k = 0; ours && pcs && k < pcs->count(); ++k) {
+                Ptr<SketchEntity> e = pcs->item(k)->sketchEntity();
+                ours = e && tokens.count(e->entityToken()) > 0;
+            }
+        }
+        if (ours)
+            found.push_back(prof);
+    }
+    return found;
+}
+
+// One extrude feature (new bodies) for all given profiles
+inline bool extrudeProfiles(const Ptr<Sketch>& sk, const std::vector<Ptr<Profile>>& profiles, double distanceCm, std::string& err)
+{
+    Ptr<Component> comp = sk ? sk->parentComponent() : nullptr;
+    Ptr<ExtrudeFeatures> extrudes = comp ? comp->features()->extrudeFeatures() : nullptr;
+    Ptr<ObjectCollection> coll = ObjectCollection::create();
+    if (!extrudes || !coll)
+    {
+        err = "Extrude is not available for this sketch.";
+        return false;
+    }
+    for (const Ptr<Profile>& p : profiles)
+        coll->add(p);
+    if (coll->count() == 0)
+    {
+        err = "No closed profiles found in the created geometry.";
+        return false;
+    }
+    Ptr<ExtrudeFeatureInput> input = extrudes->createInput(coll, FeatureOperations::NewBodyFeatureOperation);
+    if (!input || !input->setDistanceExtent(false, ValueInput::createByReal(distanceCm)) || !extrudes->add(input))
+    {
+        err = "Extrude failed.";
+        return false;
+    }
+    return true;
+}
+
+// Debug: dump all inputs
+//inline void DumpInputs(const Ptr<CommandInputs>& ins, std::string_view tag)
+//{
+//    if (!ins) return;
+//    LogFusion(std::string("[DumpInputs] ") + std::string(tag));
+//    for (size_t i = 0; i < ins->count(); ++i) {
+//        auto ci = ins->item(i);
+//        if (!ci) continue;
+//        LogFusion(std::string("  id='") + ci->id() + "'  type=" + ci->objectType());
+//    }
+//}
+
+class ThickLineInputChangedEventHandler : public InputChangedEventHandler
+{
+public:
+    void notify(const Ptr<InputChangedEventArgs>& eventArgs) override
+    {
+        Ptr<CommandInputs> inputs = eventArgs->inputs();
+        Ptr<CommandInput> changed = eventArgs->input();
+        if (!inputs || !changed)
+            return;
+
+        if (changed->id() == kSelPointAId)
+        {
+			Ptr<SelectionCommandInput> selA = changed->cast<SelectionCommandInput>();
+            if (selA && selA->selectionCount() == 1)
+            {
+                // User just finished picking point A -> set focus to point B
+                Ptr<CommandInputs> allInputs = inputs->command()->commandInputs(); // inputs only contains inputs of group A - need access to group B
+                if (!allInputs)
+                    return;
+                Ptr<SelectionCommandInput> selB = allInputs->itemById(kSelPointBId)->cast<SelectionCommandInput>();
+                if (selB)
+                    selB->hasFocus(true);
+            }
+        }
+
+        if (changed->id() == kModeId)
+            updateModeInputs(inputs);
+
+        if (changed->id() == kGroupMarkers || changed->id() == kGroupExtrude)
+        {
+            Ptr<GroupCommandInput> group = changed->cast<GroupCommandInput>();
+            if (group && group->isExpanded())
+                ensureGroupInputs(group);
+        }
+
+        if (changed->id() == kFeatATypeId)
+            updateFeatureInputs(inputs, kFeatATypeId, kFeatAWidthId, kFeatALengthId);
+
+        if (changed->id() == kFeatBTypeId)
+            updateFeatureInputs(inputs, kFeatBTypeId, kFeatBWidthId, kFeatBLengthId);
+
+        if (changed->id() == kWidthId)
+        {
+            Ptr<ValueCommandInput> widthIn = inputs->itemById(kWidthId)->cast<ValueCommandInput>();
+            double widthVal = widthIn ? widthIn->value() : 0.0;
+
+            Ptr<ValueCommandInput> aW = inputs->itemById(kFeatAWidthId)->cast<ValueCommandInput>();
+            Ptr<ValueCommandInput> bW = inputs->itemById(kFeatBWidthId)->cast<ValueCommandInput>();
+            if (aW) aW->minimumValue(widthVal);
+            if (bW) bW->minimumValue(widthVal);
+        }
+    }
+} _thickLineInputChangedHandler;
+
+class ThickLineValidateInputsEventHandler : public ValidateInputsEventHandler
+{
+public:
+    void notify(const Ptr<ValidateInputsEventArgs>& eventArgs) override
+    {
+        Ptr<CommandInputs> inputs = eventArgs->inputs();
+        if (!inputs)
+            return;
+
+		// Extract and validate parameters
+		ThickLineJob job;
+		std::string err;
+		bool ok = buildJob(inputs, job, err);
+		if (ok)
+		{
+			Ptr<BoolValueCommandInput> extrude = inputById<BoolValueCommandInput>(inputs, kExtrudeId);
+			Ptr<ValueCommandInput> dist = inputById<ValueCommandInput>(inputs, kExtrudeDistId);
+			if (extrude && extrude->value() && (!dist || dist->value() <= 0))
+			{
+				ok = false;
+				err = "Extrude distance must be > 0.";
+			}
+		}
+
+		syncErrorBox(inputs, ok, err);
+
+		eventArgs->areInputsValid(ok);
+    }
+} _thickLineValidateInputsHandler;
 
 class ThickLineCommandEventHandler : public CommandEventHandler
 {
 public:
     void notify(const Ptr<CommandEventArgs>& eventArgs) override
     {
-        Ptr<adsk::core::Command> cmd = eventArgs->command();
-        Ptr<adsk::core::CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
-        if (!cmd || !inputs)
+        Ptr<adsk::core::Command> cmd = eventArgs->command();
+        Ptr<adsk::core::CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        if (!cmd || !inputs)
+            return;
+
+        // Extract and validate parameters
+        ThickLineJob job;
+        std::string err;
+        if (!buildJob(inputs, job, err))
+        {
+            LogFusion("[ThickLine] Command failed: " + err + "\n");
+            return;
+		}
+		const ThickLineParams& P = job.style;
+
+		// Build outlines, then emit them with the configured strategy
+		ThickLineSettings S = loadSettingsIni(); // keep emission settings, tuning and cost model
+		std::vector<Ptr<SketchCurve>> created;  // exactly what this run made
+		Box2 bounds;
+		if (job.mode == "Sweep")
+		{
+			// every variant is a single line of its own (own record), all in one batch
+			std::vector<ThickLineJob> variants(job.lines.size());
+			for (size_t i = 0; i < job.lines.size(); ++i)
+			{
+				variants[i].style = job.lines[i];
+				variants[i].points = { job.lines[i].A, job.lines[i].B };
+			}
+			size_t invalid = 0;
+			regenerateJobs(P.sketch, variants, S, "Sweep", invalid, &created, &bounds);
+
+			std::filesystem::path spec = appDataDir() / "sweeps" /
+				("sweep_" + std::to_string(std::chrono::system_clock::now().time_since_epoch() / std::chrono::seconds(1)) + ".csv");
+			if (writeSweepSpec(spec, job.lines, job.labels))
+				LogFusion("[ThickLine] Sweep of " + std::to_string(job.lines.size()) + " variants, spec written to: " + spec.string());
+			S.sweep = job.sweep;
+		}
+		else
+		{
+			std::vector<Outline> outlines;
+			buildBatchOutlines(job.lines, outlines, S.workerThreads);
+			outlines.insert(outlines.end(), job.shared.begin(), job.shared.end());
+			SketchIndex* index = cachedSketchIndex(P.sketch);
+			created = emitBatch(P.sketch, outlines, S);
+			job.kerfCm = kerfFor(S, OutputTarget::Sketch); // as emitBatch applied it
+			job.kerfRoundJoins = S.kerfRoundJoins;
+			recordJob(job, created, 0, created.size(), index); // parameters for copy / paste
+			if (index)
+				index->revision = sketchRevision(P.sketch);
+			for (const Outline& o : outlines)
+				bounds.add(outlineBox(o));
+		}
+
+		// Optionally extrude the new profiles, all in one feature
+		Ptr<BoolValueCommandInput> extrudeIn = inputById<BoolValueCommandInput>(inputs, kExtrudeId);
+		Ptr<ValueCommandInput> extrudeDistIn = inputById<ValueCommandInput>(inputs, kExtrudeDistId);
+		if (extrudeIn) // group never opened: keep the saved choice (off, or it would have been built)
+			S.extrude = extrudeIn->value();
+		if (extrudeDistIn)
+			S.extrudeDist_cm = extrudeDistIn->value();
+		if (S.extrude)
+		{
+			const double grown = std::max(0.0, kerfFor(S, OutputTarget::Sketch)); // emitted outlines were offset
+			bounds.x0 -= grown;
+			bounds.y0 -= grown;
+			bounds.x1 += grown;
+			bounds.y1 += grown;
+			std::vector<Ptr<Profile>> profiles = profilesOfCurves(P.sketch, created, bounds);
+			if (!extrudeProfiles(P.sketch, profiles, S.extrudeDist_cm, err))
+				LogFusion("[ThickLine] " + err);
+		}
+
+		S.mode = job.mode;
+		S.width_cm = P.widthCm;
+		S.leadA_cm = P.leadACm;
+		S.featAType = P.featAType;
+		S.featAL_cm = P.featALCm;
+		S.featAW_cm = P.featAWCm;
+        S.leadB_cm = P.leadBCm;
+        S.featBType = P.featBType;
+        S.featBL_cm = P.featBLCm;
+		S.featBW_cm = P.featBWCm;
+		S.capFillet_cm = P.capFilletCm;
+		S.markerSpacing_cm = P.markerSpacingCm;
+		if (P.markerSpacingCm > 0) {
+			S.markerW_cm = P.markerWCm;
+			S.markerL_cm = P.markerLCm;
+		}
+        saveSettingsIni(S); // save current settings
+
+		LogFusion("[ThickLine] Settings saved to: " + settingsPath().string());
+    }
+} _thickLineCommandHandler;
+
+// ---- Preview with level of detail ----
+// Full outlines when zoomed in, centrelines when lines are thinner than a few pixels, and merged
+// boxes from a grid hierarchy when even the lines shrink to a few pixels. The hierarchy (and the
+// outlines) are built once per job and reused for every camera change. Only what lies in the
+// viewport (plus a margin) is drawn, found through R-trees over the outlines and centrelines, so
+// the cost follows what is on screen; the preview is redone when the view leaves the drawn area.
+
+enum class PreviewLod { Full = 0, Centreline, Boxes };
+
+// Upper bound for line segments drawn in one preview
+constexpr size_t kPreviewMaxSegments = 20000;
+
+// Drawn area around the viewport, as a fraction of the view size on each side
+constexpr double kPreviewCullMargin = 0.5;
+
+// FNV-1a over the geometry of a job (detects when the preview hierarchy must be rebuilt)
+inline uint64_t jobSignature(const ThickLineJob& job)
+{
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const void* p, size_t n) {
+        const unsigned char* b = (const unsigned char*)p;
+        for (size_t i = 0; i < n; ++i) { h ^= b[i]; h *= 1099511628211ull; }
+    };
+    for (const ThickLineParams& P : job.lines) {
+        const double v[] = { P.A.x, P.A.y, P.B.x, P.B.y, P.widthCm, P.leadACm, P.leadBCm, P.capFilletCm, P.featAWCm, P.featALCm,
+                             P.featBWCm, P.featBLCm, P.markerSpacingCm, P.markerWCm, P.markerLCm };
+        mix(v, sizeof(v));
+        mix(P.featAType.data(), P.featAType.size());
+        mix(P.featBType.data(), P.featBType.size());
+    }
+    for (const Outline& o : job.shared)
+        if (!o.pts.empty())
+            mix(o.pts.data(), o.pts.size() * sizeof(V2));
+    return h;
+}
+
+struct PreviewHierarchy {
+    uint64_t key = 0;
+    bool built = false;
+    std::vector<Outline> outlines;         // full detail
+    std::vector<uint32_t> outlineSegments; // per outline: segments drawn
+    size_t fullSegments = 0;
+    OutlineRTree outlineTree;
+    std::vector<V2> centreline;            // two points per line
+    OutlineRTree centreTree;
+    double typicalWidth = 0, typicalLen = 0; // medians (cm)
+    double cell0 = 1;                      // cell size of level 0 (cm), doubling per level
+    std::vector<std::vector<Box2>> levels; // merged boxes per level
+};
+
+static PreviewHierarchy g_PreviewHier;
+
+// What the current preview shows, and the command to refresh when the camera changes
+static struct PreviewState {
+    Ptr<Command> cmd;
+    bool shown = false;
+    PreviewLod lod = PreviewLod::Full;
+    size_t level = 0;
+    bool culled = false;
+    Box2 drawn;                            // area drawn when culled (sketch space)
+    Ptr<Sketch> sketch;
+} g_Preview;
+
+inline double medianOf(std::vector<double> v)
+{
+    if (v.empty())
+        return 0;
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+}
+
+inline void buildPreviewHierarchy(const ThickLineJob& job, uint64_t key, unsigned threads)
+{
+    PreviewHierarchy& h = g_PreviewHier;
+    h = PreviewHierarchy();
+    h.key = key;
+    h.built = true;
+
+    buildBatchOutlines(job.lines, h.outlines, threads);
+    h.outlines.insert(h.outlines.end(), job.shared.begin(), job.shared.end());
+    std::vector<OutlineSeg> segs;
+    std::vector<Box2> boxes;
+    boxes.reserve(h.outlines.size());
+    h.outlineSegments.reserve(h.outlines.size());
+    for (const Outline& o : h.outlines) {
+        outlineSegments(o, segs);
+        uint32_t n = 0;
+        for (const OutlineSeg& g : segs)
+            n += g.arc ? 4 : 1;
+        h.outlineSegments.push_back(n);
+        h.fullSegments += n;
+        boxes.push_back(outlineBox(o));
+    }
+    h.outlineTree.build(boxes);
+
+    std::vector<double> widths, lengths;
+    widths.reserve(job.lines.size());
+    lengths.reserve(job.lines.size());
+    h.centreline.reserve(job.lines.size() * 2);
+    for (const ThickLineParams& P : job.lines) {
+        h.centreline.push_back(P.Aext);
+        h.centreline.push_back(P.Bext);
+        widths.push_back(P.widthCm);
+        lengths.push_back(vlen(vsub(P.Bext, P.Aext)));
+    }
+    if (job.mode == "Chain") // one merged outline, no lines: the route segments
+        for (size_t i = 0; i + 1 < job.points.size(); ++i) {
+            h.centreline.push_back(job.points[i]);
+            h.centreline.push_back(job.points[i + 1]);
+            widths.push_back(job.style.widthCm);
+            lengths.push_back(vlen(vsub(job.points[i + 1], job.points[i])));
+        }
+    boxes.assign(h.centreline.size() / 2, Box2());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        boxes[i].add(h.centreline[2 * i]);
+        boxes[i].add(h.centreline[2 * i + 1]);
+    }
+    h.centreTree.build(boxes);
+    h.typicalWidth = medianOf(widths);
+    h.typicalLen = medianOf(lengths);
+    h.cell0 = std::max(h.typicalLen, kEpsSketchLen) * 4.0;
+
+    // level 0: one box per grid cell, holding the outlines whose centre falls in it
+    std::unordered_map<uint64_t, Box2> cells;
+    auto cellKey = [](double x, double y, double size) {
+        return ((uint64_t)(uint32_t)(int32_t)std::floor(x / size) << 32) | (uint32_t)(int32_t)std::floor(y / size);
+    };
+    for (const Outline& o : h.outlines) {
+        Box2 b = outlineBox(o);
+        V2 c = b.centre();
+        cells[cellKey(c.x, c.y, h.cell0)].add(b);
+    }
+
+    // coarser levels merge the boxes of 2x2 cells
+    double size = h.cell0;
+    for (int k = 0; k < 16; ++k) {
+        std::vector<Box2> level;
+        level.reserve(cells.size());
+        for (const auto& kv : cells)
+            level.push_back(kv.second);
+        h.levels.push_back(std::move(level));
+        if (cells.size() <= 1)
+            break;
+        size *= 2;
+        std::unordered_map<uint64_t, Box2> merged;
+        for (const auto& kv : cells) {
+            V2 c = kv.second.centre();
+            merged[cellKey(c.x, c.y, size)].add(kv.second);
+        }
+        cells.swap(merged);
+    }
+}
+
+// Point on the sketch plane seen at a viewport position (false when that ray misses the plane)
+inline bool viewToSketch(const Ptr<Viewport>& vp, const Ptr<Point2D>& pos, const Ptr<Sketch>& sk, V2& out)
+{
+    Ptr<Camera> cam = vp ? vp->camera() : nullptr;
+    Ptr<Point3D> p = cam && pos ? vp->viewToModelSpace(pos) : nullptr;
+    Ptr<Matrix3D> inv = p && sk ? sk->transform() : nullptr;
+    if (!inv || !inv->invert())
+        return false;
+    std::vector<double> m = inv->asArray();
+
+    // view ray in sketch space
+    Ptr<Point3D> eye = cam->eye(), target = cam->target();
+    double ps[3], es[3], ts[3];
+    transformPoint(m, p->x(), p->y(), p->z(), ps);
+    transformPoint(m, eye->x(), eye->y(), eye->z(), es);
+    transformPoint(m, target->x(), target->y(), target->z(), ts);
+    const bool ortho = cam->cameraType() == CameraTypes::OrthographicCameraType;
+    double d[3];
+    for (int k = 0; k < 3; ++k)
+        d[k] = ortho ? ts[k] - es[k] : ps[k] - es[k]; // parallel rays / rays from the eye
+    if (std::fabs(d[2]) < kEpsCoincident)
+        return false;
+    double t = -ps[2] / d[2];
+    if (!ortho && t <= -1)
+        return false; // plane behind the eye
+    out = v2(ps[0] + t * d[0], ps[1] + t * d[1]);
+    return true;
+}
+
+// Part of the sketch plane the active viewport shows (false when the view reaches the horizon)
+inline bool viewportSketchBox(const Ptr<Sketch>& sk, Box2& out)
+{
+    Ptr<Viewport> vp = _app ? _app->activeViewport() : nullptr;
+    if (!vp || vp->width() <= 0 || vp->height() <= 0)
+        return false;
+    out = Box2();
+    const double cx[] = { 0, (double)vp->width(), (double)vp->width(), 0 };
+    const double cy[] = { 0, 0, (double)vp->height(), (double)vp->height() };
+    for (int i = 0; i < 4; ++i) {
+        V2 p;
+        if (!viewToSketch(vp, Point2D::create(cx[i], cy[i]), sk, p))
+            return false;
+        out.add(p);
+    }
+    return true;
+}
+
+// Viewport area plus the cull margin, to be drawn (false: draw everything)
+inline bool previewArea(const Ptr<Sketch>& sk, Box2& out)
+{
+    if (!viewportSketchBox(sk, out))
+        return false;
+    double mx = (out.x1 - out.x0) * kPreviewCullMargin, my = (out.y1 - out.y0) * kPreviewCullMargin;
+    out.x0 -= mx;
+    out.x1 += mx;
+    out.y0 -= my;
+    out.y1 += my;
+    return true;
+}
+
+// Size of a screen pixel in model units (cm) for the active viewport
+inline double viewportCmPerPixel()
+{
+    Ptr<Viewport> vp = _app ? _app->activeViewport() : nullptr;
+    Ptr<Camera> cam = vp ? vp->camera() : nullptr;
+    if (!cam)
+        return 0;
+    int pixels = std::min(vp->width(), vp->height());
+    return pixels > 0 ? cam->viewExtents() / pixels : 0;
+}
+
+// Pick the level of detail for the hierarchy at the given pixel size, counting only what lies in
+// view (all without)
+inline PreviewLod choosePreviewLod(const PreviewHierarchy& h, double px, size_t& level, const Box2* view = nullptr)
+{
+    level = 0;
+    size_t fullSegments = h.fullSegments, lines = h.centreline.size() / 2;
+    if (view) {
+        fullSegments = lines = 0;
+        h.outlineTree.query(*view, [&](uint32_t i) { fullSegments += h.outlineSegments[i]; });
+        h.centreTree.query(*view, [&](uint32_t) { ++lines; });
+    }
+    if (fullSegments <= kPreviewMaxSegments && (px <= 0 || h.typicalWidth >= 2 * px))
+        return PreviewLod::Full;
+    if (lines <= kPreviewMaxSegments && (px <= 0 || h.typicalLen >= 4 * px))
+        return PreviewLod::Centreline;
+    // boxes of about 8 pixels or more, within the segment budget (4 per box)
+    double cell = h.cell0;
+    while (level + 1 < h.levels.size() && (cell < 8 * px || h.levels[level].size() * 4 > kPreviewMaxSegments)) {
+        ++level;
+        cell *= 2;
+    }
+    return PreviewLod::Boxes;
+}
+
+// Points along a three-point arc (end points included)
+inline void arcPoints(const V2& a, const V2& m, const V2& b, int pieces, std::vector<V2>& out)
+{
+    // circumcentre of a, m, b
+    double d = 2 * (a.x * (m.y - b.y) + m.x * (b.y - a.y) + b.x * (a.y - m.y));
+    if (std::fabs(d) <= kEpsCoincident) {
+        out.push_back(a);
+        out.push_back(b);
+        return;
+    }
+    double a2 = vdot(a, a), m2 = vdot(m, m), b2 = vdot(b, b);
+    V2 c = v2((a2 * (m.y - b.y) + m2 * (b.y - a.y) + b2 * (a.y - m.y)) / d,
+              (a2 * (b.x - m.x) + m2 * (a.x - b.x) + b2 * (m.x - a.x)) / d);
+    double r = vlen(vsub(a, c));
+    double t0 = std::atan2(a.y - c.y, a.x - c.x);
+    double tm = std::atan2(m.y - c.y, m.x - c.x);
+    double t1 = std::atan2(b.y - c.y, b.x - c.x);
+    // sweep from t0 to t1 through tm
+    const double kTwoPi = 6.28318530717958647692;
+    double sweep = std::fmod(t1 - t0 + 2 * kTwoPi, kTwoPi);
+    double toMid = std::fmod(tm - t0 + 2 * kTwoPi, kTwoPi);
+    if (toMid > sweep)
+        sweep -= kTwoPi;
+    for (int i = 0; i <= pieces; ++i) {
+        double t = t0 + sweep * i / pieces;
+        out.push_back(v2(c.x + r * std::cos(t), c.y + r * std::sin(t)));
+    }
+}
+
+// Draw the preview of a job as custom graphics (in model space), only what overlaps view if given
+inline void drawPreview(const Ptr<Sketch>& sketch, PreviewLod lod, size_t level, const Box2* view = nullptr)
+{
+    Ptr<Design> design = _app ? _app->activeProduct()->cast<Design>() : nullptr;
+    if (!design || !sketch)
+        return;
+    const PreviewHierarchy& h = g_PreviewHier;
+
+    // sketch -> model transform, applied here instead of one API call per point
+    std::vector<double> m = sketch->transform()->asArray();
+    if (m.size() != 16)
+        return;
+    std::vector<double> coords;
+    std::vector<int> index;
+    auto addPoint = [&](const V2& p) {
+        coords.push_back(m[0] * p.x + m[1] * p.y + m[3]);
+        coords.push_back(m[4] * p.x + m[5] * p.y + m[7]);
+        coords.push_back(m[8] * p.x + m[9] * p.y + m[11]);
+        return (int)(coords.size() / 3 - 1);
+    };
+    auto addSegment = [&](const V2& a, const V2& b) {
+        index.push_back(addPoint(a));
+        index.push_back(addPoint(b));
+    };
+
+    if (lod == PreviewLod::Full) {
+        std::vector<OutlineSeg> segs;
+        std::vector<V2> pts;
+        std::vector<uint32_t> shown;
+        if (view)
+            h.outlineTree.query(*view, [&](uint32_t i) { shown.push_back(i); });
+        else
+            for (uint32_t i = 0; i < h.outlines.size(); ++i)
+                shown.push_back(i);
+        for (uint32_t i : shown) {
+            outlineSegments(h.outlines[i], segs);
+            for (const OutlineSeg& g : segs) {
+                if (!g.arc) {
+                    addSegment(g.a, g.b);
+                    continue;
+                }
+                pts.clear();
+                arcPoints(g.a, g.mid, g.b, 4, pts);
+                for (size_t i = 0; i + 1 < pts.size(); ++i)
+                    addSegment(pts[i], pts[i + 1]);
+            }
+        }
+    }
+    else if (lod == PreviewLod::Centreline) {
+        if (view)
+            h.centreTree.query(*view, [&](uint32_t i) { addSegment(h.centreline[2 * i], h.centreline[2 * i + 1]); });
+        else
+            for (size_t i = 0; i + 1 < h.centreline.size(); i += 2)
+                addSegment(h.centreline[i], h.centreline[i + 1]);
+    }
+    else if (level < h.levels.size()) {
+        for (const Box2& b : h.levels[level]) {
+            if (view && !b.overlaps(*view))
+                continue;
+            V2 c[4] = { v2(b.x0, b.y0), v2(b.x1, b.y0), v2(b.x1, b.y1), v2(b.x0, b.y1) };
+            for (int i = 0; i < 4; ++i)
+                addSegment(c[i], c[(i + 1) % 4]);
+        }
+    }
+    if (index.empty())
+        return;
+
+    Ptr<CustomGraphicsGroup> group = design->rootComponent()->customGraphicsGroups()->add();
+    Ptr<CustomGraphicsCoordinates> cgCoords = group ? CustomGraphicsCoordinates::create(coords) : nullptr;
+    if (cgCoords)
+        group->addLines(cgCoords, index, false);
+}
+
+class ThickLinePreviewEventHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        if (!inputs)
+            return;
+
+        ThickLineJob job;
+        std::string err;
+        if (!buildJob(inputs, job, err))
+            return;
+
+        uint64_t key = jobSignature(job);
+        if (!g_PreviewHier.built || g_PreviewHier.key != key)
+            buildPreviewHierarchy(job, key, loadSettingsIni().workerThreads);
+
+        g_Preview.cmd = cmd;
+        g_Preview.culled = previewArea(job.style.sketch, g_Preview.drawn);
+        const Box2* view = g_Preview.culled ? &g_Preview.drawn : nullptr;
+        g_Preview.lod = choosePreviewLod(g_PreviewHier, viewportCmPerPixel(), g_Preview.level, view);
+        g_Preview.shown = true;
+        g_Preview.sketch = job.style.sketch;
+        drawPreview(job.style.sketch, g_Preview.lod, g_Preview.level, view);
+    }
+} _thickLinePreviewHandler;
+
+// Redo the preview when a camera change moves it to another level of detail, outside the drawn
+// area, or zooms in far enough that much less would be drawn
+class ThickLineCameraChangedEventHandler : public CameraEventHandler
+{
+public:
+    void notify(const Ptr<CameraEventArgs>& eventArgs) override
+    {
+        if (!g_Preview.cmd || !g_Preview.shown || !g_PreviewHier.built)
+            return;
+        Box2 view, area;
+        bool cull = viewportSketchBox(g_Preview.sketch, view) && previewArea(g_Preview.sketch, area);
+        if (cull != g_Preview.culled) {
+            g_Preview.cmd->doExecutePreview();
+            return;
+        }
+        if (cull) {
+            const Box2& d = g_Preview.drawn;
+            bool inside = view.x0 >= d.x0 && view.x1 <= d.x1 && view.y0 >= d.y0 && view.y1 <= d.y1;
+            double shrink = ((d.x1 - d.x0) * (d.y1 - d.y0)) / std::max((area.x1 - area.x0) * (area.y1 - area.y0), kEpsCoincident);
+            if (!inside || shrink > 16) {
+                g_Preview.cmd->doExecutePreview();
+                return;
+            }
+        }
+        size_t level = 0;
+        PreviewLod lod = choosePreviewLod(g_PreviewHier, viewportCmPerPixel(), level, cull ? &g_Preview.drawn : nullptr);
+        if (lod != g_Preview.lod || level != g_Preview.level)
+            g_Preview.cmd->doExecutePreview();
+    }
+} _thickLineCameraChangedHandler;
+
+class ThickLineDestroyEventHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        if (_app && _app->cameraChanged())
+            _app->cameraChanged()->remove(&_thickLineCameraChangedHandler);
+        g_Preview = PreviewState();
+        g_OccTransforms.clear();
+        g_PreviewHier = PreviewHierarchy(); // release the outlines
+    }
+} _thickLineDestroyHandler;
+
+// ---- Copy / paste commands ----
+
+// sin of the largest angle between sketch planes that paste still maps through world space
+constexpr double kPasteParallelSin = 1e-6;
+
+// Sketch -> world transform (row-major 4x4). The sketch transform is relative to its component;
+// the occurrence the sketch is reached through (a proxy), or the activated occurrence when the
+// sketch belongs to its component, places it in the assembly.
+inline bool sketchWorldFrame(const Ptr<Sketch>& sk, std::vector<double>& out)
+{
+    if (!sk)
+        return false;
+    Ptr<Occurrence> occ = sk->assemblyContext();
+    Ptr<Sketch> native = occ ? sk->nativeObject() : sk;
+    if (!occ) {
+        Ptr<Design> design = _app ? _app->activeProduct()->cast<Design>() : nullptr;
+        Ptr<Occurrence> active = design ? design->activeOccurrence() : nullptr;
+        Ptr<Component> comp = sk->parentComponent();
+        Ptr<Component> activeComp = active ? active->component() : nullptr;
+        if (comp && activeComp && comp->entityToken() == activeComp->entityToken())
+            occ = active;
+    }
+    Ptr<Matrix3D> m = native ? native->transform() : nullptr;
+    if (!m)
+        return false;
+    if (occ) {
+        Ptr<Matrix3D> placement = occ->transform2(); // occurrence -> root, through all its parents
+        if (!placement || !m->transformBy(placement))
+            return false;
+    }
+    out = m->asArray();
+    return out.size() == 16;
+}
+
+// True when the planes of two frames are parallel (their z axes are)
+inline bool parallelFrames(const std::vector<double>& a, const std::vector<double>& b)
+{
+    const double na[3] = { a[2], a[6], a[10] }, nb[3] = { b[2], b[6], b[10] };
+    const double c[3] = { na[1] * nb[2] - na[2] * nb[1], na[2] * nb[0] - na[0] * nb[2], na[0] * nb[1] - na[1] * nb[0] };
+    const double la = std::sqrt(na[0] * na[0] + na[1] * na[1] + na[2] * na[2]);
+    const double lb = std::sqrt(nb[0] * nb[0] + nb[1] * nb[1] + nb[2] * nb[2]);
+    return std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]) <= kPasteParallelSin * la * lb;
+}
+
+static const char* kCopyCmdId = "habiThickLineCopy";
+static const char* kPasteCmdId = "habiThickLinePaste";
+static const char* kCopySelId = "tlc_sel";
+
+class ThickLineCopyCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        Ptr<SelectionCommandInput> sel = inputs ? inputs->itemById(kCopySelId)->cast<SelectionCommandInput>() : nullptr;
+        if (!sel)
+            return;
+
+        // each record once, however many of its curves are selected
+        std::vector<std::string> seen;
+        std::vector<ClipRecord> clip;
+        for (size_t i = 0; i < sel->selectionCount(); ++i) {
+            Ptr<SketchCurve> curve = sel->selection(i)->entity()->cast<SketchCurve>();
+            Ptr<Sketch> sk = curve ? curve->parentSketch() : nullptr;
+            Ptr<Attribute> tag = curve && curve->attributes() ? curve->attributes()->itemByName(kAttrGroup, kAttrJobId) : nullptr;
+            if (!sk || !tag)
+                continue;
+            std::string key = sk->entityToken() + "/" + tag->value();
+            if (std::find(seen.begin(), seen.end(), key) != seen.end())
+                continue;
+            seen.push_back(key);
+
+            Ptr<Attribute> rec = sk->attributes()->itemByName(kAttrGroup, kAttrJobId + tag->value());
+            ThickLineJob job;
+            std::vector<double> coords;
+            int dims = 0;
+            std::string err;
+            if (!rec || !decodeJobRecord(rec->value(), job, coords, dims, err) || dims != 2) {
+                LogFusion("[ThickLine] Copy: skipped a line without a valid record.");
+                continue;
+            }
+
+            // the record stays in sketch space; the world frame lets paste place it in any sketch
+            ClipRecord c;
+            c.record = rec->value();
+            if (!sketchWorldFrame(sk, c.frame)) {
+                LogFusion("[ThickLine] Copy: skipped a line whose sketch has no placement.");
+                continue;
+            }
+            clip.push_back(std::move(c));
+        }
+        g_Clipboard.swap(clip);
+        LogFusion("[ThickLine] Copied " + std::to_string(g_Clipboard.size()) + " thick line record(s).");
+    }
+} _thickLineCopyCommandHandler;
+
+class ThickLineCopyCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        if (!inputs)
+            return;
+        Ptr<SelectionCommandInput> sel = inputs->addSelectionInput(kCopySelId, "Thick lines", "Select curves of the thick lines to copy");
+        if (sel) {
+            sel->addSelectionFilter("SketchCurves");
+            sel->setSelectionLimits(1, 0);
+            // start from what is selected (e.g. by Select Thick Lines)
+            Ptr<Selections> active = _ui->activeSelections();
+            for (size_t i = 0; active && i < active->count(); ++i)
+                if (active->item(i)->entity()->cast<SketchCurve>())
+                    sel->addSelection(active->item(i)->entity());
+        }
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLineCopyCommandHandler);
+    }
+} _thickLineCopyCommandCreatedHandler;
+
+class ThickLinePasteCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Sketch> target = _app ? _app->activeEditObject()->cast<Sketch>() : nullptr;
+        if (!target) {
+            LogFusion("[ThickLine] Paste: open the target sketch first.");
+            return;
+        }
+        if (g_Clipboard.empty()) {
+            LogFusion("[ThickLine] Paste: nothing copied.");
+            return;
+        }
+
+        // world -> target sketch space
+        std::vector<double> targetFrame;
+        if (!sketchWorldFrame(target, targetFrame))
+            return;
+        Ptr<Matrix3D> inv = Matrix3D::create();
+        for (int r = 0; r < 4; ++r)
+            for (int c = 0; c < 4; ++c)
+                inv->setCell(r, c, targetFrame[r * 4 + c]);
+        if (!inv->invert())
+            return;
+        std::vector<double> m = inv->asArray();
+
+        std::vector<ThickLineJob> jobs;
+        size_t tilted = 0;
+        for (const ClipRecord& c : g_Clipboard) {
+            ThickLineJob job;
+            std::vector<double> coords;
+            int dims = 0;
+            std::string err;
+            if (!decodeJobRecord(c.record, job, coords, dims, err) || dims != 2) {
+                LogFusion("[ThickLine] Paste: " + err);
+                continue;
+            }
+            // parallel planes: same place in the world (moved along the normal onto the target);
+            // otherwise world space would flatten the lines, so they keep their sketch coordinates
+            const bool parallel = parallelFrames(c.frame, targetFrame);
+            tilted += parallel ? 0 : 1;
+            for (size_t k = 0; k + 1 < coords.size(); k += 2) {
+                if (!parallel) {
+                    job.points.push_back(v2(coords[k], coords[k + 1]));
+                    continue;
+                }
+                double w[3], t[3];
+                transformPoint(c.frame, coords[k], coords[k + 1], 0.0, w);
+                transformPoint(m, w[0], w[1], w[2], t);
+                job.points.push_back(v2(t[0], t[1]));
+            }
+            jobs.push_back(std::move(job));
+        }
+        if (tilted)
+            LogFusion("[ThickLine] Paste: " + std::to_string(tilted) + " record(s) come from a sketch plane not parallel"
+                      " to the target and keep their sketch coordinates.");
+
+        ThickLineSettings S = loadSettingsIni();
+        size_t invalid = 0;
+        regenerateJobs(target, jobs, S, "Paste", invalid);
+        saveSettingsIni(S); // keep tuning and cost model
+
+        LogFusion("[ThickLine] Pasted " + std::to_string(jobs.size()) + " thick line record(s).");
+    }
+} _thickLinePasteCommandHandler;
+
+class ThickLinePasteCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        if (!cmd)
+            return;
+        cmd->isAutoExecute(true); // no inputs, pastes into the active sketch
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLinePasteCommandHandler);
+    }
+} _thickLinePasteCommandCreatedHandler;
+
+// ---- CSV import ----
+// One thick line per row: ax, ay, bx, by [, width [, leadA [, leadB]]] in cm (sketch space),
+// separated by ',', ';' or tabs. Sizes not given and the features come from the last used
+// settings. Lines starting with '#' and a header row are skipped.
+// The file is memory mapped, split at newlines into chunks that are parsed in parallel, and the
+// chunk results are merged in file order.
+
+constexpr size_t kImportCols = 7;                  // values per row in ImportBatch
+constexpr size_t kImportChunkBytes = 1 << 20;      // bytes per parse chunk (ends at a newline)
+
+// Parsed rows, kImportCols values each (NaN where the column is absent)
+struct ImportBatch {
+    std::vector<double> v;
+    size_t rows() const { return v.size() / kImportCols; }
+    size_t badRows = 0;
+    size_t firstBadLine = 0; // 1-based, 0 = none
+};
+
+// Read-only view of a whole file; memory mapped where possible, read into memory otherwise
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size{};
+        if (file_ != INVALID_HANDLE_VALUE && GetFileSizeEx(file_, &size) && size.QuadPart > 0) {
+            map_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (map_)
+                data_ = (const char*)MapViewOfFile(map_, FILE_MAP_READ, 0, 0, 0);
+            if (data_)
+                size_ = (size_t)size.QuadPart;
+        }
+#else
+        fd_ = open(path.c_str(), O_RDONLY);
+        struct stat st{};
+        if (fd_ >= 0 && fstat(fd_, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (p != MAP_FAILED) {
+                data_ = (const char*)p;
+                size_ = (size_t)st.st_size;
+            }
+        }
+#endif
+        if (data_)
+            return;
+        // no mapping (empty file, special file system): plain read
+        std::ifstream f(path, std::ios::binary);
+        if (!f)
+            return;
+        copy_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        ok_ = true;
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (map_) CloseHandle(map_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if (data_) munmap((void*)data_, size_);
+        if (fd_ >= 0) close(fd_);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const { return data_ != nullptr || ok_; }
+    const char* data() const { return data_ ? data_ : copy_.data(); }
+    size_t size() const { return data_ ? size_ : copy_.size(); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<char> copy_;
+    bool ok_ = false;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE map_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// Parse a number at p (leading blanks and '+' allowed); advances p past it
+inline bool parseNumber(const char*& p, const char* end, double& v)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    if (p < end && *p == '+') { // only before a digit or '.': no second sign, no "+inf"
+        if (p + 1 == end || !((p[1] >= '0' && p[1] <= '9') || p[1] == '.'))
+            return false;
+        ++p;
+    }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::from_chars_result r = std::from_chars(p, end, v);
+    if (r.ec != std::errc() || r.ptr == p)
+        return false;
+    p = r.ptr;
+    return true;
+#else
+    // no floating point from_chars in this standard library: strtod on a terminated copy
+    char buf[64];
+    size_t n = 0;
+    // (strchr also finds the terminator of its set, so a '\0' byte has to be excluded)
+    while (p + n < end && n + 1 < sizeof(buf) && p[n] != '\0' && std::strchr("0123456789.eE+-infINFaA", p[n]))
+        ++n;
+    std::memcpy(buf, p, n);
+    buf[n] = '\0';
+    char* stop = nullptr;
+    v = std::strtod(buf, &stop);
+    if (stop == buf)
+        return false;
+    p += stop - buf;
+    return true;
+#endif
+}
+
+// Parse the rows in [begin, end); line numbers are counted from firstLine (1-based)
+inline void parseCsvChunk(const char* begin, const char* end, size_t firstLine, ImportBatch& out)
+{
+    const double nan = std::nan("");
+    size_t line = firstLine;
+    for (const char* p = begin; p < end; ++line) {
+        const char* eol = (const char*)std::memchr(p, '\n', (size_t)(end - p));
+        if (!eol)
+            eol = end;
+        const char* q = p;
+        const char* stop = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+        p = eol + 1;
+
+        while (q < stop && (*q == ' ' || *q == '\t'))
+            ++q;
+        if (q == stop || *q == '#')
+            continue;
+
+        double row[kImportCols];
+        size_t cols = 0;
+        bool ok = true;
+        while (cols < kImportCols) {
+            if (!parseNumber(q, stop, row[cols]) || !std::isfinite(row[cols])) {
+                ok = false;
+                break;
+            }
+            ++cols;
+            while (q < stop && *q == ' ') // not tabs, they may be the separator
+                ++q;
+            if (q == stop)
+                break;
+            if (*q != ',' && *q != ';' && *q != '\t') {
+                ok = false;
+                break;
+            }
+            ++q;
+        }
+        if (ok && q != stop)
+            ok = false; // more columns than known
+        if (!ok || cols < 4) {
+            if (line == 1 && cols == 0)
+                continue; // header
+            if (out.badRows++ == 0)
+                out.firstBadLine = line;
+            continue;
+        }
+        for (size_t c = cols; c < kImportCols; ++c)
+            row[c] = nan;
+        out.v.insert(out.v.end(), row, row + kImportCols);
+    }
+}
+
+// Parse a whole file in parallel; rows come out in file order for any thread count
+inline void parseCsvParallel(const char* data, size_t size, unsigned threads, ImportBatch& out)
+{
+    // chunk starts at fixed offsets, moved forward to the next line start
+    std::vector<size_t> starts(1, 0);
+    for (size_t at = kImportChunkBytes; at < size; at += kImportChunkBytes) {
+        if (at <= starts.back())
+            continue;
+        const char* nl = (const char*)std::memchr(data + at, '\n', size - at);
+        if (!nl)
+            break;
+        size_t next = (size_t)(nl - data) + 1;
+        if (next < size)
+            starts.push_back(next);
+        at = next - next % kImportChunkBytes;
+    }
+    starts.push_back(size);
+    const size_t chunks = starts.size() - 1;
+
+    // line numbers of the chunk starts (needed for messages), counted while parsing
+    std::vector<ImportBatch> parts(chunks);
+    std::vector<size_t> lines(chunks, 0);
+    parallelChunks(chunks, 1, threads, [&](size_t c, size_t, size_t)
+    {
+        const char* b = data + starts[c];
+        const char* e = data + starts[c + 1];
+        lines[c] = (size_t)std::count(b, e, '\n');
+        parts[c].v.reserve((size_t)(e - b) / 32 * kImportCols);
+        parseCsvChunk(b, e, c == 0 ? 1 : 2, parts[c]); // 2: only the very first line may be a header
+    });
+
+    size_t total = 0;
+    for (const ImportBatch& p : parts)
+        total += p.v.size();
+    out.v.reserve(out.v.size() + total);
+    size_t lineBase = 0;
+    for (size_t c = 0; c < chunks; ++c) {
+        ImportBatch& p = parts[c];
+        out.v.insert(out.v.end(), p.v.begin(), p.v.end());
+        if (p.badRows && out.badRows == 0)
+            out.firstBadLine = lineBase + p.firstBadLine - (c == 0 ? 0 : 1);
+        out.badRows += p.badRows;
+        lineBase += lines[c];
+    }
+}
+
+static const char* kImportCmdId = "habiThickLineImport";
+
+class ThickLineImportCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Sketch> sketch = getActiveSketch();
+        if (!sketch) {
+            LogFusion("[ThickLine] Import: open the target sketch first.");
+            return;
+        }
+        Ptr<FileDialog> dlg = _ui->createFileDialog();
+        if (!dlg)
+            return;
+        dlg->title("Import Thick Lines");
+        dlg->filter("CSV files (*.csv);;All files (*.*)");
+        if (dlg->showOpen() != DialogOK)
+            return;
+
+        auto t0 = std::chrono::steady_clock::now();
+        ThickLineSettings S = loadSettingsIni();
+        ImportBatch batch;
+        {
+            MappedFile file(std::filesystem::u8path(dlg->filename()));
+            if (!file.ok()) {
+                LogFusion("[ThickLine] Import: cannot read " + dlg->filename());
+                return;
+            }
+            parseCsvParallel(file.data(), file.size(), S.workerThreads, batch);
+        }
+        double parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (batch.badRows)
+            LogFusion("[ThickLine] Import: skipped " + std::to_string(batch.badRows) + " bad row(s), first at line " +
+                      std::to_string(batch.firstBadLine) + ".");
+
+        // every row is a single line job with the last used style
+        ThickLineJob style;
+        style.mode = "Single";
+        style.style.sketch = sketch;
+        style.style.widthCm = S.width_cm;
+        style.style.leadACm = S.leadA_cm;
+        style.style.leadBCm = S.leadB_cm;
+        style.style.capFilletCm = S.capFillet_cm;
+        style.style.markerSpacingCm = S.markerSpacing_cm;
+        style.style.markerWCm = S.markerW_cm;
+        style.style.markerLCm = S.markerL_cm;
+        style.style.featAType = S.featAType == "Pad" ? "None" : S.featAType;
+        style.style.featAWCm = S.featAW_cm;
+        style.style.featALCm = S.featAL_cm;
+        style.style.featBType = S.featBType;
+        style.style.featBWCm = S.featBW_cm;
+        style.style.featBLCm = S.featBL_cm;
+
+        std::vector<ThickLineJob> jobs(batch.rows(), style);
+        for (size_t r = 0; r < batch.rows(); ++r) {
+            const double* row = &batch.v[r * kImportCols];
+            ThickLineJob& job = jobs[r];
+            job.points = { v2(row[0], row[1]), v2(row[2], row[3]) };
+            if (!std::isnan(row[4])) job.style.widthCm = row[4];
+            if (!std::isnan(row[5])) job.style.leadACm = row[5];
+            if (!std::isnan(row[6])) job.style.leadBCm = row[6];
+        }
+        size_t invalid = 0;
+        regenerateJobs(sketch, jobs, S, "Import", invalid);
+        saveSettingsIni(S); // keep tuning and cost model
+
+        LogFusion("[ThickLine] Imported " + std::to_string(jobs.size()) + " line(s) (" + std::to_string(invalid) +
+                  " invalid), parsed in " + std::to_string(parseSeconds * 1000) + " ms.");
+    }
+} _thickLineImportCommandHandler;
+
+class ThickLineImportCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        if (!cmd)
+            return;
+        cmd->isAutoExecute(true); // asks for the file, imports into the active sketch
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLineImportCommandHandler);
+    }
+} _thickLineImportCommandCreatedHandler;
+
+// ---- Line library files (.tll) ----
+// Binary, little endian:
+//   header   "TLLB", u32 version, f64 quantum (cm), u64 index offset, u32 blocks, u32 records
+//   dictionary: varint count, then varint length + bytes per string (modes and feature types)
+//   blocks of up to kLibBlockRecords records, each decodable on its own
+//   index: u64 offset, u32 bytes, u32 records per block
+// A record is: dictionary indices of mode, feature A and B; the 11 sizes; varint point count and
+// the points. Sizes and points are quantized to multiples of the quantum and stored as zigzag
+// varint deltas (sizes against the previous record, the first point against the previous
+// record's first point, other points against the point before), so repeated styles and nearby
+// points take a byte or two.
+
+constexpr uint32_t kLibVersion = 1;
+constexpr size_t kLibHeaderBytes = 32;
+constexpr size_t kLibBlockRecords = 256;
+constexpr double kLibQuantumCm = 1e-5; // 0.1 um
+constexpr size_t kLibSizes = 11;
+
+inline void libSizes(const ThickLineParams& P, double v[kLibSizes])
+{
+    const double s[kLibSizes] = { P.widthCm, P.leadACm, P.leadBCm, P.capFilletCm, P.markerSpacingCm, P.markerWCm,
+                                  P.markerLCm, P.featAWCm, P.featALCm, P.featBWCm, P.featBLCm };
+    std::copy(s, s + kLibSizes, v);
+}
+
+inline void libSetSizes(ThickLineParams& P, const double v[kLibSizes])
+{
+    double* d[kLibSizes] = { &P.widthCm, &P.leadACm, &P.leadBCm, &P.capFilletCm, &P.markerSpacingCm, &P.markerWCm,
+                             &P.markerLCm, &P.featAWCm, &P.featALCm, &P.featBWCm, &P.featBLCm };
+    for (size_t k = 0; k < kLibSizes; ++k)
+        *d[k] = v[k];
+}
+
+// Largest quantized value (in quanta) a library stores
+constexpr int64_t kLibMaxQuantized = 4000000000000000000LL;
+
+inline void putVarint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+inline void putZigzag(std::string& out, int64_t v) { putVarint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+
+inline void putFixed(std::string& out, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out.push_back((char)(v >> (8 * i)));
+}
+
+// Bounds-checked reader over a byte range
+struct LibCursor {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok = true;
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end)
+                break;
+            unsigned char b = *p++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+    int64_t zigzag() { uint64_t v = varint(); return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+    // acc += the next zigzag delta, added unsigned so a damaged delta can't overflow; a sum
+    // outside what libQuantize writes marks the data damaged
+    void accumulate(int64_t& acc)
+    {
+        acc = (int64_t)((uint64_t)acc + (uint64_t)zigzag());
+        if (acc > kLibMaxQuantized || acc < -kLibMaxQuantized)
+            ok = false;
+    }
+    uint64_t fixed(int bytes)
+    {
+        if (end - p < bytes) {
+            ok = false;
+            return 0;
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i)
+            v |= (uint64_t)*p++ << (8 * i);
+        return v;
+    }
+};
+
+inline bool libQuantize(double v, double quantum, int64_t& q)
+{
+    double x = std::round(v / quantum);
+    if (!std::isfinite(x) || std::fabs(x) > (double)kLibMaxQuantized)
+        return false;
+    q = (int64_t)x;
+    return true;
+}
+
+// Encode jobs (mode, style and sketch space points) as a library file image
+inline bool encodeLineLibrary(const std::vector<ThickLineJob>& jobs, std::string& out, std::string& err)
+{
+    const double quantum = kLibQuantumCm;
+    std::vector<std::string> dict;
+    auto dictIndex = [&dict](const std::string& s) {
+        auto it = std::find(dict.begin(), dict.end(), s);
+        if (it != dict.end())
+            return (uint64_t)(it - dict.begin());
+        dict.push_back(s);
+        return (uint64_t)(dict.size() - 1);
+    };
+
+    std::string blocks;
+    struct IndexEntry { uint64_t offset; uint32_t bytes, records; };
+    std::vector<IndexEntry> index;
+    int64_t prevSize[kLibSizes] = {};
+    int64_t prevFirst[2] = {};
+    for (size_t r = 0; r < jobs.size(); ++r) {
+        if (r % kLibBlockRecords == 0) {
+            // a new block starts from a clean state
+            index.push_back({ (uint64_t)blocks.size(), 0, 0 });
+            std::fill(prevSize, prevSize + kLibSizes, 0);
+            prevFirst[0] = prevFirst[1] = 0;
+        }
+        const ThickLineJob& job = jobs[r];
+        putVarint(blocks, dictIndex(job.mode));
+        putVarint(blocks, dictIndex(job.style.featAType));
+        putVarint(blocks, dictIndex(job.style.featBType));
+
+        double sizes[kLibSizes];
+        libSizes(job.style, sizes);
+        for (size_t k = 0; k < kLibSizes; ++k) {
+            int64_t q;
+            if (!libQuantize(sizes[k], quantum, q)) {
+                err = "Size out of range in item " + std::to_string(r + 1) + ".";
+                return false;
+            }
+            putZigzag(blocks, q - prevSize[k]);
+            prevSize[k] = q;
+        }
+
+        putVarint(blocks, job.points.size());
+        int64_t prev[2] = { prevFirst[0], prevFirst[1] };
+        for (size_t i = 0; i < job.points.size(); ++i) {
+            int64_t q[2];
+            if (!libQuantize(job.points[i].x, quantum, q[0]) || !libQuantize(job.points[i].y, quantum, q[1])) {
+                err = "Point out of range in item " + std::to_string(r + 1) + ".";
+                return false;
+            }
+            putZigzag(blocks, q[0] - prev[0]);
+            putZigzag(blocks, q[1] - prev[1]);
+            prev[0] = q[0];
+            prev[1] = q[1];
+            if (i == 0) {
+                prevFirst[0] = q[0];
+                prevFirst[1] = q[1];
+            }
+        }
+        index.back().records++;
+    }
+
+    std::string dictBytes;
+    putVarint(dictBytes, dict.size());
+    for (const std::string& s : dict) {
+        putVarint(dictBytes, s.size());
+        dictBytes += s;
+    }
+
+    const uint64_t blocksAt = kLibHeaderBytes + dictBytes.size();
+    for (size_t b = 0; b < index.size(); ++b) {
+        uint64_t end = b + 1 < index.size() ? index[b + 1].offset : blocks.size();
+        index[b].bytes = (uint32_t)(end - index[b].offset);
+        index[b].offset += blocksAt;
+    }
+
+    uint64_t pq;
+    std::memcpy(&pq, &quantum, sizeof(pq));
+    out.clear();
+    out.reserve(blocksAt + blocks.size() + index.size() * 16);
+    out += "TLLB";
+    putFixed(out, kLibVersion, 4);
+    putFixed(out, pq, 8);
+    putFixed(out, blocksAt + blocks.size(), 8);
+    putFixed(out, index.size(), 4);
+    putFixed(out, jobs.size(), 4);
+    out += dictBytes;
+    out += blocks;
+    for (const IndexEntry& e : index) {
+        putFixed(out, e.offset, 8);
+        putFixed(out, e.bytes, 4);
+        putFixed(out, e.records, 4);
+    }
+    return true;
+}
+
+// Random access to the blocks of a library file image (typically memory mapped)
+class LineLibraryReader
+{
+public:
+    bool open(const char* data, size_t size, std::string& err)
+    {
+        data_ = (const unsigned char*)data;
+        size_ = size;
+        dict_.clear();
+        index_.clear();
+        records_ = 0;
+        err = "Not a thick line library, or a damaged one.";
+        if (size < kLibHeaderBytes || std::memcmp(data, "TLLB", 4) != 0)
+            return false;
+
+        LibCursor h{ data_ + 4, data_ + kLibHeaderBytes };
+        if (h.fixed(4) != kLibVersion) {
+            err = "Unsupported thick line library version.";
+            return false;
+        }
+        uint64_t pq = h.fixed(8);
+        std::memcpy(&quantum_, &pq, sizeof(pq));
+        uint64_t indexAt = h.fixed(8);
+        uint64_t blocks = h.fixed(4);
+        records_ = (size_t)h.fixed(4);
+        if (!(quantum_ > 0) || indexAt > size || (size - indexAt) / 16 < blocks)
+            return false;
+
+        LibCursor d{ data_ + kLibHeaderBytes, data_ + indexAt };
+        uint64_t n = d.varint();
+        for (uint64_t i = 0; i < n && d.ok; ++i) {
+            uint64_t len = d.varint();
+            if (!d.ok || len > (uint64_t)(d.end - d.p))
+                return false;
+            dict_.emplace_back((const char*)d.p, (size_t)len);
+            d.p += len;
+        }
+
+        LibCursor ix{ data_ + indexAt, data_ + size };
+        for (uint64_t b = 0; b < blocks; ++b) {
+            Block e;
+            e.offset = ix.fixed(8);
+            e.bytes = ix.fixed(4);
+            e.records = (size_t)ix.fixed(4);
+            if (e.offset > indexAt || e.bytes > indexAt - e.offset)
+                return false;
+            index_.push_back(e);
+        }
+        if (!d.ok || !ix.ok)
+            return false;
+        err.clear();
+        return true;
+    }
+
+    size_t blockCount() const { return index_.size(); }
+    size_t recordCount() const { return records_; }
+
+    // Decode one block (appends to out); safe to call from several threads at once
+    bool readBlock(size_t b, std::vector<ThickLineJob>& out, std::string& err) const
+    {
+        const Block& e = index_[b];
+        LibCursor c{ data_ + e.offset, data_ + e.offset + e.bytes };
+        int64_t prevSize[kLibSizes] = {};
+        int64_t prevFirst[2] = {};
+        auto word = [&](uint64_t i) -> const std::string& {
+            static const std::string none;
+            if (i >= dict_.size()) {
+                c.ok = false;
+                return none;
+            }
+            return dict_[i];
+        };
+        for (size_t r = 0; r < e.records && c.ok; ++r) {
+            ThickLineJob job;
+            job.mode = word(c.varint());
+            job.style.featAType = word(c.varint());
+            job.style.featBType = word(c.varint());
+
+            double sizes[kLibSizes];
+            for (size_t k = 0; k < kLibSizes; ++k) {
+                c.accumulate(prevSize[k]);
+                sizes[k] = prevSize[k] * quantum_;
+            }
+            libSetSizes(job.style, sizes);
+
+            uint64_t n = c.varint();
+            if (n > (uint64_t)(c.end - c.p) / 2) // two varints, so two bytes at least per point
+                c.ok = false;
+            else
+                job.points.reserve((size_t)n);
+            int64_t prev[2] = { prevFirst[0], prevFirst[1] };
+            for (uint64_t i = 0; i < n && c.ok; ++i) {
+                c.accumulate(prev[0]);
+                c.accumulate(prev[1]);
+                if (i == 0) {
+                    prevFirst[0] = prev[0];
+                    prevFirst[1] = prev[1];
+                }
+                job.points.push_back(v2(prev[0] * quantum_, prev[1] * quantum_));
+            }
+            if (c.ok)
+                out.push_back(std::move(job));
+        }
+        if (!c.ok)
+            err = "Damaged block " + std::to_string(b + 1) + " in thick line library.";
+        return c.ok;
+    }
+
+private:
+    struct Block { uint64_t offset = 0, bytes = 0; size_t records = 0; };
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    double quantum_ = kLibQuantumCm;
+    size_t records_ = 0;
+    std::vector<std::string> dict_;
+    std::vector<Block> index_;
+};
+
+// Records stored on a sketch (see recordJob), points in sketch space; ids (optional) receives
+// the record id of each
+inline std::vector<ThickLineJob> sketchJobs(const Ptr<Sketch>& sk, std::vector<std::string>* ids = nullptr)
+{
+    std::vector<ThickLineJob> jobs;
+    Ptr<Attributes> attrs = sk ? sk->attributes() : nullptr;
+    if (!attrs)
+        return jobs;
+    const std::string prefix = kAttrJobId;
+    for (size_t i = 0; i < attrs->count(); ++i) {
+        Ptr<Attribute> a = attrs->item(i);
+        if (!a || a->groupName() != kAttrGroup || a->name().compare(0, prefix.size(), prefix) != 0)
+            continue;
+        ThickLineJob job;
+        std::vector<double> coords;
+        int dims = 0;
+        std::string err;
+        if (!decodeJobRecord(a->value(), job, coords, dims, err) || dims != 2)
+            continue;
+        for (size_t k = 0; k + 1 < coords.size(); k += 2)
+            job.points.push_back(v2(coords[k], coords[k + 1]));
+        jobs.push_back(std::move(job));
+        if (ids)
+            ids->push_back(a->name().substr(prefix.size()));
+    }
+    return jobs;
+}
+
+static const char* kLibExportCmdId = "habiThickLineLibExport";
+static const char* kLibImportCmdId = "habiThickLineLibImport";
+
+class ThickLineLibExportCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Sketch> sketch = getActiveSketch();
+        std::vector<ThickLineJob> jobs = sketchJobs(sketch);
+        if (jobs.empty()) {
+            LogFusion("[ThickLine] Library export: the active sketch has no thick lines.");
+            return;
+        }
+        Ptr<FileDialog> dlg = _ui->createFileDialog();
+        if (!dlg)
+            return;
+        dlg->title("Export Thick Line Library");
+        dlg->filter("Thick line libraries (*.tll)");
+        if (dlg->showSave() != DialogOK)
+            return;
+
+        std::string image, err;
+        if (!encodeLineLibrary(jobs, image, err)) {
+            LogFusion("[ThickLine] Library export: " + err);
+            return;
+        }
+        std::ofstream f(std::filesystem::u8path(dlg->filename()), std::ios::binary | std::ios::trunc);
+        if (!f.write(image.data(), (std::streamsize)image.size())) {
+            LogFusion("[ThickLine] Library export: cannot write " + dlg->filename());
+            return;
+        }
+        LogFusion("[ThickLine] Exported " + std::to_string(jobs.size()) + " thick line record(s), " +
+                  std::to_string(image.size()) + " bytes.");
+    }
+} _thickLineLibExportCommandHandler;
+
+class ThickLineLibImportCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Sketch> sketch = getActiveSketch();
+        if (!sketch) {
+            LogFusion("[ThickLine] Library import: open the target sketch first.");
+            return;
+        }
+        Ptr<FileDialog> dlg = _ui->createFileDialog();
+        if (!dlg)
+            return;
+        dlg->title("Import Thick Line Library");
+        dlg->filter("Thick line libraries (*.tll)");
+        if (dlg->showOpen() != DialogOK)
+            return;
+
+        ThickLineSettings S = loadSettingsIni();
+        std::vector<ThickLineJob> jobs;
+        {
+            MappedFile file(std::filesystem::u8path(dlg->filename()));
+            LineLibraryReader lib;
+            std::string err;
+            if (!file.ok() || !lib.open(file.data(), file.size(), err)) {
+                LogFusion("[ThickLine] Library import: " + (err.empty() ? "cannot read " + dlg->filename() : err));
+                return;
+            }
+            // blocks decode independently; merge in file order
+            std::vector<std::vector<ThickLineJob>> parts(lib.blockCount());
+            std::vector<std::string> errs(lib.blockCount());
+            parallelChunks(lib.blockCount(), 1, S.workerThreads, [&](size_t b, size_t, size_t)
+            {
+                lib.readBlock(b, parts[b], errs[b]);
+            });
+            jobs.reserve(lib.recordCount());
+            for (size_t b = 0; b < parts.size(); ++b) {
+                if (!errs[b].empty())
+                    LogFusion("[ThickLine] Library import: " + errs[b]);
+                jobs.insert(jobs.end(), std::make_move_iterator(parts[b].begin()), std::make_move_iterator(parts[b].end()));
+            }
+        }
+
+        size_t invalid = 0;
+        size_t made = regenerateJobs(sketch, jobs, S, "Library import", invalid);
+        saveSettingsIni(S); // keep tuning and cost model
+        LogFusion("[ThickLine] Imported " + std::to_string(made) + " thick line record(s) (" + std::to_string(invalid) + " invalid).");
+    }
+} _thickLineLibImportCommandHandler;
+
+// Both library commands just run (file dialog only)
+class ThickLineLibCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandDefinition> def = cmd ? cmd->parentCommandDefinition() : nullptr;
+        if (!def)
+            return;
+        cmd->isAutoExecute(true);
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (!commandEvent)
+            return;
+        if (def->id() == kLibExportCmdId)
+            commandEvent->add(&_thickLineLibExportCommandHandler);
+        else
+            commandEvent->add(&_thickLineLibImportCommandHandler);
+    }
+} _thickLineLibCommandCreatedHandler;
+
+// Curves of a sketch by the record id they are tagged with
+inline std::unordered_map<std::string, std::vector<Ptr<SketchCurve>>> taggedCurves(const Ptr<Sketch>& sk)
+{
+    std::unordered_map<std::string, std::vector<Ptr<SketchCurve>>> byId;
+    Ptr<Design> design = _app ? _app->activeProduct()->cast<Design>() : nullptr;
+    Ptr<AttributeList> tags = design && sk ? design->findAttributes(kAttrGroup, kAttrJobId) : nullptr;
+    const std::string token = sk ? sk->entityToken() : std::string();
+    for (size_t i = 0; tags && i < tags->count(); ++i) {
+        Ptr<Attribute> tag = tags->item(i);
+        Ptr<SketchCurve> curve = tag ? tag->parent()->cast<SketchCurve>() : nullptr;
+        if (curve && curve->parentSketch() && curve->parentSketch()->entityToken() == token)
+            byId[tag->value()].push_back(curve);
+    }
+    return byId;
+}
+
+inline bool buildSketchIndex(const Ptr<Sketch>& sk, SketchIndex& index, unsigned threads)
+{
+    index = SketchIndex();
+    if (!sk)
+        return false;
+    index.sketchToken = sk->entityToken();
+    index.revision = sketchRevision(sk);
+
+    std::vector<std::string> ids;
+    std::vector<ThickLineJob> jobs = sketchJobs(sk, &ids);
+    std::vector<ThickLineParams> lines;
+    std::vector<uint32_t> lineRecord;
+    std::vector<Outline> shared;
+    std::vector<uint32_t> sharedRecord;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        ThickLineJob& job = jobs[j];
+        job.style.sketch = sk;
+        std::string err;
+        if (!buildJobLines(job, err))
+            continue;
+        uint32_t rec = (uint32_t)index.records.size();
+        index.records.push_back(ids[j]);
+        index.recordOf[ids[j]] = rec;
+        lines.insert(lines.end(), job.lines.begin(), job.lines.end());
+        lineRecord.insert(lineRecord.end(), job.lines.size(), rec);
+        shared.insert(shared.end(), job.shared.begin(), job.shared.end());
+        sharedRecord.insert(sharedRecord.end(), job.shared.size(), rec);
+    }
+
+    std::vector<size_t> lineEnds;
+    buildBatchOutlines(lines, index.outlines, threads, &lineEnds);
+    for (size_t l = 0, o = 0; l < lines.size(); ++l)
+        for (; o < lineEnds[l]; ++o)
+            index.outlineRecord.push_back(lineRecord[l]);
+    index.outlines.insert(index.outlines.end(), shared.begin(), shared.end());
+    index.outlineRecord.insert(index.outlineRecord.end(), sharedRecord.begin(), sharedRecord.end());
+
+    std::vector<Box2> boxes(index.outlines.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+        boxes[i] = outlineBox(index.outlines[i]);
+    index.tree.build(boxes);
+
+    // curves per record, from their tags
+    std::unordered_map<std::string, std::vector<Ptr<SketchCurve>>> tagged = taggedCurves(sk);
+    index.curves.resize(index.records.size());
+    index.dead.assign(index.records.size(), 0);
+    index.outlineCount.assign(index.records.size(), 0);
+    for (uint32_t rec : index.outlineRecord)
+        index.outlineCount[rec]++;
+    for (uint32_t r = 0; r < index.records.size(); ++r) {
+        auto it = tagged.find(index.records[r]);
+        if (it != tagged.end())
+            index.curves[r].swap(it->second);
+    }
+    return true;
+}
+
+// Index of a sketch, from the cache or built and cached now (nullptr without a sketch)
+inline SketchIndex* sketchIndex(const Ptr<Sketch>& sk, unsigned threads)
+{
+    if (SketchIndex* cached = cachedSketchIndex(sk))
+        return cached;
+    SketchIndex index;
+    if (!buildSketchIndex(sk, index, threads))
+        return nullptr;
+    while (g_SketchIndexes.size() >= kMaxSketchIndexes) { // the least recently used makes room
+        auto oldest = g_SketchIndexes.begin();
+        for (auto e = g_SketchIndexes.begin(); e != g_SketchIndexes.end(); ++e)
+            if (e->second.lastUse < oldest->second.lastUse)
+                oldest = e;
+        g_SketchIndexes.erase(oldest);
+    }
+    index.lastUse = ++g_SketchIndexClock;
+    SketchIndex& slot = g_SketchIndexes[index.sketchToken];
+    slot = std::move(index);
+    return &slot;
+}
+
+// Point on the sketch plane under a mouse click (false when looking along the plane)
+inline bool clickToSketch(const Ptr<MouseEventArgs>& args, const Ptr<Sketch>& sk, V2& out)
+{
+    return args && viewToSketch(args->viewport(), args->viewportPosition(), sk, out);
+}
+
+static const char* kPickCmdId = "habiThickLinePick";
+static const char* kPickSelId = "tlp_sel";
+
+static Ptr<Command> g_PickCmd; // the open pick command (mouse events don't carry it)
+
+// Click inside a thick line: select all its curves
+class ThickLinePickClickHandler : public MouseEventHandler
+{
+public:
+    void notify(const Ptr<MouseEventArgs>& eventArgs) override
+    {
+        Ptr<Sketch> sk = getActiveSketch();
+        SketchIndex* index = cachedSketchIndex(sk);
+        V2 p;
+        if (!index || !clickToSketch(eventArgs, sk, p))
+            return;
+        int rec = index->hit(p);
+        Ptr<CommandInputs> inputs = g_PickCmd ? g_PickCmd->commandInputs() : nullptr;
+        Ptr<SelectionCommandInput> sel = inputs ? inputs->itemById(kPickSelId)->cast<SelectionCommandInput>() : nullptr;
+        if (rec < 0 || !sel)
+            return;
+        for (const Ptr<SketchCurve>& c : index->curves[rec])
+            if (c && c->isValid())
+                sel->addSelection(c);
+    }
+} _thickLinePickClickHandler;
+
+// OK: leave the picked curves selected for the next command (copy, delete, ...)
+class ThickLinePickCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        Ptr<SelectionCommandInput> sel = inputs ? inputs->itemById(kPickSelId)->cast<SelectionCommandInput>() : nullptr;
+        Ptr<Selections> active = _ui->activeSelections();
+        if (!sel || !active)
+            return;
+        active->clear();
+        for (size_t i = 0; i < sel->selectionCount(); ++i)
+            active->add(sel->selection(i)->entity());
+    }
+} _thickLinePickCommandHandler;
+
+class ThickLinePickDestroyHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        g_PickCmd = nullptr; // the index stays cached for the next time
+    }
+} _thickLinePickDestroyHandler;
+
+class ThickLinePickCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        if (!inputs)
+            return;
+        Ptr<SelectionCommandInput> sel = inputs->addSelectionInput(kPickSelId, "Thick lines", "Click inside thick lines to select them");
+        if (sel) {
+            sel->addSelectionFilter("SketchCurves");
+            sel->setSelectionLimits(0, 0);
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        Ptr<Sketch> sk = getActiveSketch();
+        bool cached = cachedSketchIndex(sk) != nullptr;
+        SketchIndex* index = sketchIndex(sk, loadSettingsIni().workerThreads);
+        if (index)
+            LogFusion("[ThickLine] Hit-test index of " + std::to_string(index->recordOf.size()) + " thick line(s) " +
+                      (cached ? "reused" : "built") + " in " +
+                      std::to_string(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() * 1000) + " ms.");
+
+        g_PickCmd = cmd;
+        Ptr<MouseEvent> click = cmd->mouseClick();
+        if (click)
+            click->add(&_thickLinePickClickHandler);
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLinePickCommandHandler);
+        Ptr<CommandEvent> destroyEvent = cmd->destroy();
+        if (destroyEvent)
+            destroyEvent->add(&_thickLinePickDestroyHandler);
+    }
+} _thickLinePickCommandCreatedHandler;
+
+// ---- Clean up ----
+// Finds thick lines whose geometry was partly deleted (fixed leftovers that only slow solving),
+// records without any geometry, and tagged curves without a record. Partial lines are
+// regenerated (all in one batch) or deleted, the rest is removed, and a report is logged.
+
+static const char* kCleanCmdId = "habiThickLineClean";
+static const char* kCleanPartialId = "tlg_partial";
+static const char* kCleanDryRunId = "tlg_dryRun";
+
+struct CleanReport {
+    size_t complete = 0;
+    size_t partial = 0;        // regenerated or deleted
+    size_t emptyRecords = 0;   // record left, geometry gone
+    size_t orphanCurves = 0;   // tagged, but no record
+    size_t damaged = 0;        // record that cannot be read
+    size_t deletedCurves = 0;
+};
+
+inline CleanReport cleanSketch(const Ptr<Sketch>& sk, bool regenerate, bool dryRun, ThickLineSettings& S)
+{
+    CleanReport rep;
+    Ptr<Attributes> attrs = sk ? sk->attributes() : nullptr;
+    if (!attrs)
+        return rep;
+
+    std::unordered_map<std::string, std::vector<Ptr<SketchCurve>>> tagged = taggedCurves(sk);
+    std::vector<Ptr<SketchCurve>> doomed;
+    std::vector<Ptr<Attribute>> doomedRecords;
+    std::vector<ThickLineJob> redo;
+
+    const std::string prefix = kAttrJobId;
+    std::vector<Outline> outlines;
+    for (size_t i = 0; i < attrs->count(); ++i) {
+        Ptr<Attribute> a = attrs->item(i);
+        if (!a || a->groupName() != kAttrGroup || a->name().compare(0, prefix.size(), prefix) != 0)
+            continue;
+        std::string id = a->name().substr(prefix.size());
+        auto it = tagged.find(id);
+        std::vector<Ptr<SketchCurve>> curves;
+        if (it != tagged.end()) {
+            curves.swap(it->second);
+            tagged.erase(it);
+        }
+
+        ThickLineJob job;
+        std::vector<double> coords;
+        int dims = 0;
+        std::string err;
+        bool ok = decodeJobRecord(a->value(), job, coords, dims, err) && dims == 2;
+        for (size_t k = 0; ok && k + 1 < coords.size(); k += 2)
+            job.points.push_back(v2(coords[k], coords[k + 1]));
+        job.style.sketch = sk;
+        if (!ok || !buildJobLines(job, err)) {
+            // unreadable: only drop it once its geometry is gone as well
+            rep.damaged++;
+            if (curves.empty())
+                doomedRecords.push_back(a);
+            continue;
+        }
+        if (curves.empty()) {
+            rep.emptyRecords++;
+            doomedRecords.push_back(a);
+            continue;
+        }
+
+        outlines.clear();
+        for (const ThickLineParams& P : job.lines)
+            buildOutlines(P, outlines);
+        outlines.insert(outlines.end(), job.shared.begin(), job.shared.end());
+        offsetOutlines(outlines, job.kerfCm, job.kerfRoundJoins); // as emitted, whatever the settings are now
+        size_t expected = 0;
+        for (const Outline& o : outlines)
+            expected += outlineCurveCount(o);
+        if (curves.size() >= expected) {
+            rep.complete++;
+            continue;
+        }
+
+        rep.partial++;
+        doomed.insert(doomed.end(), curves.begin(), curves.end());
+        doomedRecords.push_back(a);
+        if (regenerate)
+            redo.push_back(std::move(job));
+    }
+
+    // tags pointing to no record
+    for (auto& kv : tagged) {
+        rep.orphanCurves += kv.second.size();
+        doomed.insert(doomed.end(), kv.second.begin(), kv.second.end());
+    }
+
+    if (dryRun)
+        return rep;
+
+    SketchIndex* index = cachedSketchIndex(sk);
+    const bool wasDeferred = sk->isComputeDeferred();
+    if (!wasDeferred)
+        sk->isComputeDeferred(true);
+    for (const Ptr<SketchCurve>& c : doomed)
+        if (c && c->isValid() && c->deleteMe())
+            rep.deletedCurves++;
+    for (const Ptr<Attribute>& a : doomedRecords) {
+        if (index)
+            index->remove(a->name().substr(prefix.size()));
+        a->deleteMe();
+    }
+    if (!wasDeferred)
+        sk->isComputeDeferred(false);
+    if (index)
+        index->revision = sketchRevision(sk);
+
+    size_t invalid = 0;
+    if (!redo.empty())
+        regenerateJobs(sk, redo, S, "Clean up", invalid);
+    return rep;
+}
+
+class ThickLineCleanCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        Ptr<Sketch> sk = getActiveSketch();
+        if (!inputs || !sk) {
+            LogFusion("[ThickLine] Clean up: open a sketch first.");
+            return;
+        }
+        Ptr<DropDownCommandInput> partialIn = inputs->itemById(kCleanPartialId)->cast<DropDownCommandInput>();
+        Ptr<BoolValueCommandInput> dryRunIn = inputs->itemById(kCleanDryRunId)->cast<BoolValueCommandInput>();
+        bool regenerate = !partialIn || !partialIn->selectedItem() || partialIn->selectedItem()->index() == 0;
+        bool dryRun = dryRunIn && dryRunIn->value();
+
+        ThickLineSettings S = loadSettingsIni();
+        CleanReport r = cleanSketch(sk, regenerate, dryRun, S);
+        if (!dryRun)
+            saveSettingsIni(S); // keep tuning and cost model
+
+        std::string verb = dryRun ? "to fix" : "fixed";
+        LogFusion("[ThickLine] Clean up of sketch '" + sk->name() + "'" + (dryRun ? " (report only)" : "") + ":\n" +
+                  "  complete thick lines: " + std::to_string(r.complete) + "\n" +
+                  "  partial thick lines " + (regenerate ? "regenerated: " : "deleted: ") + std::to_string(r.partial) + "\n" +
+                  "  records without geometry removed: " + std::to_string(r.emptyRecords) + "\n" +
+                  "  curves without record removed: " + std::to_string(r.orphanCurves) + "\n" +
+                  "  unreadable records: " + std::to_string(r.damaged) + "\n" +
+                  "  curves deleted: " + std::to_string(r.deletedCurves) + " (" + verb + ")");
+    }
+} _thickLineCleanCommandHandler;
+
+class ThickLineCleanCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        if (!inputs)
+            return;
+        Ptr<DropDownCommandInput> partial = inputs->addDropDownCommandInput(kCleanPartialId, "Partial lines", DropDownStyles::TextListDropDownStyle);
+        partial->listItems()->add("Regenerate", true);
+        partial->listItems()->add("Delete", false);
+        partial->tooltip("What to do with thick lines of which some curves were deleted");
+        Ptr<BoolValueCommandInput> dryRun = inputs->addBoolValueInput(kCleanDryRunId, "Report only", true, "", false);
+        dryRun->tooltip("Only log what would be cleaned up");
+
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLineCleanCommandHandler);
+    }
+} _thickLineCleanCommandCreatedHandler;
+
+// ---- Coverage density map ----
+// Area covered by thick lines per square tile, for plating balance and heat spreading. Outlines
+// are flattened once, binned to the tiles their boxes touch, and every tile is rasterized on its
+// own (tiles run in parallel) with a signed-area accumulation rasterizer: each edge adds its
+// exact area and cover to the cells it crosses, a running sum along each row gives the coverage
+// of every sample, anti-aliased. Overlapping outlines add up and are clamped to full coverage.
+
+static const char* kCoverageCmdId = "habiThickLineCoverage";
+static const char* kCoverageTileId = "tlv_tile";
+static const char* kCoverageSamplesId = "tlv_samples";
+
+struct CoverageMap {
+    double x0 = 0, y0 = 0;     // lower left corner of tile (0, 0)
+    double tileCm = 0;
+    int cols = 0, rows = 0;
+    int samples = 0;           // samples along a tile side
+    std::vector<float> density; // per tile, row major from the bottom: covered fraction 0..1
+    double coveredCm2 = 0;
+};
+
+// Outline boundary as a polygon, arcs in pieces of about 4 px (0.4 mm at most); counter-clockwise
+inline void flattenOutline(const Outline& o, double px, std::vector<OutlineSeg>& segs, std::vector<V2>& out)
+{
+    out.clear();
+    outlineSegments(o, segs);
+    for (const OutlineSeg& g : segs) {
+        if (!g.arc) {
+            out.push_back(g.a);
+            continue;
+        }
+        double len = vlen(vsub(g.mid, g.a)) + vlen(vsub(g.b, g.mid));
+        int pieces = (int)std::min(64.0, std::max(2.0, std::ceil(len / (4 * std::min(px, 0.01)))));
+        arcPoints(g.a, g.mid, g.b, pieces, out);
+        out.pop_back(); // b starts the next segment
+    }
+    double a = 0;
+    for (size_t i = 0, n = out.size(); i < n; ++i)
+        a += vcross(out[i], out[(i + 1) % n]);
+    if (a < 0)
+        std::reverse(out.begin(), out.end());
+}
+
+// Accumulate one edge (sample coordinates) into a w x h cell buffer with rows of w + 2 cells
+inline void accumulateEdge(std::vector<float>& acc, int w, int h, V2 p0, V2 p1)
+{
+    if (p0.y == p1.y || (p0.x >= w && p1.x >= w))
+        return;
+    // split at the tile sides: left of the tile an edge covers whole cells, right of it nothing kept
+    for (double side : { 0.0, (double)w })
+        if ((p0.x - side) * (p1.x - side) < 0) {
+            V2 m = v2(side, p0.y + (side - p0.x) * (p1.y - p0.y) / (p1.x - p0.x));
+            accumulateEdge(acc, w, h, p0, m);
+            accumulateEdge(acc, w, h, m, p1);
+            return;
+        }
+    float dir = 1;
+    if (p0.y > p1.y) {
+        std::swap(p0, p1);
+        dir = -1;
+    }
+    if (p1.y <= 0 || p0.y >= h)
+        return;
+    const size_t stride = (size_t)w + 2;
+    if (p0.x <= 0 && p1.x <= 0) {
+        for (int y = std::max(0, (int)p0.y), yEnd = std::min(h, (int)std::ceil(p1.y)); y < yEnd; ++y)
+            acc[y * stride] += (float)(std::min((double)y + 1, p1.y) - std::max((double)y, p0.y)) * dir;
+        return;
+    }
+    const double dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    double x = p0.x + (p0.y < 0 ? -p0.y * dxdy : 0);
+    for (int y = std::max(0, (int)p0.y), yEnd = std::min(h, (int)std::ceil(p1.y)); y < yEnd; ++y) {
+        float* row = &acc[y * stride];
+        double dy = std::min((double)y + 1, p1.y) - std::max((double)y, p0.y);
+        double xnext = x + dxdy * dy;
+        float d = (float)dy * dir;
+        double x0 = std::min(std::max(std::min(x, xnext), 0.0), (double)w);
+        double x1 = std::min(std::max(std::max(x, xnext), 0.0), (double)w);
+        double x0floor = std::floor(x0), x1ceil = std::ceil(x1);
+        int x0i = (int)x0floor, x1i = (int)x1ceil;
+        if (x1i <= x0i + 1) {
+            float xmf = (float)(0.5 * (x0 + x1) - x0floor);
+            row[x0i] += d - d * xmf;
+            row[x0i + 1] += d * xmf;
+        }
+        else {
+            float s = (float)(1.0 / (x1 - x0));
+            float x0f = (float)(x0 - x0floor);
+            float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+            float x1f = (float)(x1 - x1ceil + 1);
+            float am = 0.5f * s * x1f * x1f;
+            row[x0i] += d * a0;
+            if (x1i == x0i + 2)
+                row[x0i + 1] += d * (1 - a0 - am);
+            else {
+                float a1 = s * (1.5f - x0f);
+                row[x0i + 1] += d * (a1 - a0);
+                for (int xi = x0i + 2; xi < x1i - 1; ++xi)
+                    row[xi] += d * s;
+                float a2 = a1 + (x1i - x0i - 3) * s;
+                row[x1i - 1] += d * (1 - a2 - am);
+            }
+            row[x1i] += d * am;
+        }
+        x = xnext;
+    }
+}
+
+inline bool buildCoverageMap(const std::vector<Outline>& outlines, double tileCm, int samples, unsigned threads,
+                             CoverageMap& map, std::string& err)
+{
+    map = CoverageMap();
+    if (tileCm <= 0 || samples < 1) {
+        err = "Tile size and samples must be > 0.";
+        return false;
+    }
+    const double px = tileCm / samples;
+
+    // flatten in parallel: polygons back to back, with their boxes
+    std::vector<size_t> start(outlines.size() + 1, 0);
+    std::vector<std::vector<V2>> chunkPts((outlines.size() + kBuildChunk - 1) / kBuildChunk);
+    std::vector<Box2> boxes(outlines.size());
+    std::vector<uint32_t> counts(outlines.size());
+    parallelChunks(outlines.size(), kBuildChunk, threads, [&](size_t c, size_t begin, size_t end)
+    {
+        std::vector<OutlineSeg> segs;
+        std::vector<V2> poly;
+        for (size_t i = begin; i < end; ++i) {
+            flattenOutline(outlines[i], px, segs, poly);
+            counts[i] = (uint32_t)poly.size();
+            for (const V2& p : poly)
+                boxes[i].add(p);
+            chunkPts[c].insert(chunkPts[c].end(), poly.begin(), poly.end());
+        }
+    });
+    std::vector<V2> pts;
+    for (size_t i = 0; i < outlines.size(); ++i)
+        start[i + 1] = start[i] + counts[i];
+    pts.reserve(start.back());
+    for (std::vector<V2>& c : chunkPts)
+        pts.insert(pts.end(), c.begin(), c.end());
+
+    Box2 all;
+    for (const Box2& b : boxes)
+        if (!b.empty())
+            all.add(b);
+    if (all.empty()) {
+        err = "No thick lines to measure.";
+        return false;
+    }
+    map.tileCm = tileCm;
+    map.samples = samples;
+    map.x0 = std::floor(all.x0 / tileCm) * tileCm;
+    map.y0 = std::floor(all.y0 / tileCm) * tileCm;
+    map.cols = std::max(1, (int)std::ceil((all.x1 - map.x0) / tileCm));
+    map.rows = std::max(1, (int)std::ceil((all.y1 - map.y0) / tileCm));
+    if ((double)map.cols * map.rows > 4e6) {
+        err = "Too many tiles (" + std::to_string(map.cols) + " x " + std::to_string(map.rows) + "), use larger tiles.";
+        return false;
+    }
+
+    // bin outlines to the tiles their boxes touch
+    const size_t tiles = (size_t)map.cols * map.rows;
+    std::vector<uint32_t> binStart(tiles + 1, 0), bins;
+    auto tileRange = [&](const Box2& b, int& c0, int& c1, int& r0, int& r1) {
+        c0 = std::max(0, (int)((b.x0 - map.x0) / tileCm));
+        c1 = std::min(map.cols - 1, (int)((b.x1 - map.x0) / tileCm));
+        r0 = std::max(0, (int)((b.y0 - map.y0) / tileCm));
+        r1 = std::min(map.rows - 1, (int)((b.y1 - map.y0) / tileCm));
+    };
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<uint32_t> fill(binStart.begin(), binStart.end() - 1);
+        for (size_t i = 0; i < outlines.size(); ++i) {
+            if (boxes[i].empty())
+                continue;
+            int c0, c1, r0, r1;
+            tileRange(boxes[i], c0, c1, r0, r1);
+            for (int r = r0; r <= r1; ++r)
+                for (int c = c0; c <= c1; ++c) {
+                    size_t t = (size_t)r * map.cols + c;
+                    if (pass == 0)
+                        binStart[t + 1]++;
+                    else
+                        bins[fill[t]++] = (uint32_t)i;
+                }
+        }
+        if (pass == 0) {
+            for (size_t t = 0; t < tiles; ++t)
+                binStart[t + 1] += binStart[t];
+            bins.resize(binStart[tiles]);
+        }
+    }
+
+    // rasterize tile by tile
+    map.density.assign(tiles, 0.0f);
+    parallelChunks(tiles, 1, threads, [&](size_t t, size_t, size_t)
+    {
+        if (binStart[t] == binStart[t + 1])
+            return;
+        thread_local std::vector<float> acc;
+        acc.assign((size_t)samples * (samples + 2), 0.0f);
+        const double ox = map.x0 + (t % map.cols) * tileCm, oy = map.y0 + (t / map.cols) * tileCm;
+        auto toSample = [&](const V2& p) { return v2((p.x - ox) / px, (p.y - oy) / px); };
+        for (uint32_t k = binStart[t]; k < binStart[t + 1]; ++k) {
+            size_t i = bins[k], n = start[i + 1] - start[i];
+            const V2* poly = &pts[start[i]];
+            for (size_t j = 0; j < n; ++j)
+                accumulateEdge(acc, samples, samples, toSample(poly[j]), toSample(poly[(j + 1) % n]));
+        }
+        double sum = 0;
+        for (int y = 0; y < samples; ++y) {
+            const float* row = &acc[(size_t)y * (samples + 2)];
+            float cover = 0;
+            for (int x = 0; x < samples; ++x) {
+                cover += row[x];
+                sum += std::min(1.0f, std::fabs(cover));
+            }
+        }
+        map.density[t] = (float)(sum / ((double)samples * samples));
+    });
+    for (float d : map.density)
+        map.coveredCm2 += d * tileCm * tileCm;
+    err.clear();
+    return true;
+}
+
+inline bool writeCoverageCsv(const std::filesystem::path& path, const CoverageMap& map)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream f(path, std::ios::trunc);
+    if (!f)
+        return false;
+    f << "col,row,x0_cm,y0_cm,x1_cm,y1_cm,density\n";
+    for (int r = 0; r < map.rows; ++r)
+        for (int c = 0; c < map.cols; ++c)
+            f << c << "," << r << "," << map.x0 + c * map.tileCm << "," << map.y0 + r * map.tileCm << ","
+              << map.x0 + (c + 1) * map.tileCm << "," << map.y0 + (r + 1) * map.tileCm << ","
+              << map.density[(size_t)r * map.cols + c] << "\n";
+    return (bool)f;
+}
+
+// Heatmap as a 24-bit BMP, every tile a block of pixels: blue (empty) over green to red (full)
+inline bool writeCoverageBmp(const std::filesystem::path& path, const CoverageMap& map)
+{
+    const int scale = std::max(1, 512 / std::max(map.cols, map.rows));
+    const int w = map.cols * scale, h = map.rows * scale;
+    const size_t rowBytes = ((size_t)w * 3 + 3) & ~(size_t)3;
+    const uint32_t imageBytes = (uint32_t)(rowBytes * h);
+    std::string bmp(54, '\0');
+    auto put32 = [&](size_t at, uint32_t v) { for (int k = 0; k < 4; ++k) bmp[at + k] = (char)(v >> (8 * k)); };
+    bmp[0] = 'B';
+    bmp[1] = 'M';
+    put32(2, 54 + imageBytes);
+    put32(10, 54);
+    put32(14, 40);
+    put32(18, (uint32_t)w);
+    put32(22, (uint32_t)h); // positive: bottom row first, like the tiles
+    bmp[26] = 1;
+    bmp[28] = 24;
+    put32(34, imageBytes);
+    bmp.resize(54 + imageBytes, '\0');
+
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            float d = std::min(1.0f, std::max(0.0f, map.density[(size_t)(y / scale) * map.cols + x / scale]));
+            float r = std::min(1.0f, std::max(0.0f, 2 * d - 0.5f));
+            float g = 1 - std::fabs(2 * d - 1);
+            float b = std::min(1.0f, std::max(0.0f, 1.5f - 2 * d));
+            char* px = &bmp[54 + y * rowBytes + (size_t)x * 3];
+            px[0] = (char)(uint8_t)(b * 255);
+            px[1] = (char)(uint8_t)(g * 255);
+            px[2] = (char)(uint8_t)(r * 255);
+        }
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write(bmp.data(), (std::streamsize)bmp.size());
+    return (bool)f;
+}
+
+class ThickLineCoverageCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        Ptr<Sketch> sk = getActiveSketch();
+        if (!inputs || !sk) {
+            LogFusion("[ThickLine] Coverage: open a sketch first.");
             return;
-
-        // Extract and validate parameters
-        ThickLineParams P;
+        }
+        Ptr<ValueCommandInput> tileIn = inputs->itemById(kCoverageTileId)->cast<ValueCommandInput>();
+        Ptr<IntegerSpinnerCommandInput> samplesIn = inputs->itemById(kCoverageSamplesId)->cast<IntegerSpinnerCommandInput>();
+        ThickLineSettings S = loadSettingsIni();
+        if (tileIn)
+            S.coverageTile_cm = tileIn->value();
+        if (samplesIn)
+            S.coverageSamples = samplesIn->value();
+        saveSettingsIni(S);
+
+        auto t0 = std::chrono::steady_clock::now();
+        SketchIndex* index = sketchIndex(sk, S.workerThreads);
+        if (!index)
+            return;
+        std::vector<Outline> outlines;
+        outlines.reserve(index->outlines.size());
+        for (size_t i = 0; i < index->outlines.size(); ++i)
+            if (!index->dead[index->outlineRecord[i]])
+                outlines.push_back(index->outlines[i]);
+        compensateOutlines(outlines, S, OutputTarget::Coverage);
+        auto t1 = std::chrono::steady_clock::now();
+
+        CoverageMap map;
         std::string err;
-        if (!extractParams(inputs, P, err) || !validateParams(P, err))
-        {
-            LogFusion("[ThickLine] Command failed: " + err + "\n");
+        if (!buildCoverageMap(outlines, S.coverageTile_cm, S.coverageSamples, S.workerThreads, map, err)) {
+            LogFusion("[ThickLine] Coverage: " + err);
             return;
-		}
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        std::string stem = "coverage_" + std::to_string(std::chrono::system_clock::now().time_since_epoch() / std::chrono::seconds(1));
+        std::filesystem::path csv = appDataDir() / "coverage" / (stem + ".csv");
+        std::filesystem::path bmp = appDataDir() / "coverage" / (stem + ".bmp");
+        bool written = writeCoverageCsv(csv, map) && writeCoverageBmp(bmp, map);
+
+        float lo = *std::min_element(map.density.begin(), map.density.end());
+        float hi = *std::max_element(map.density.begin(), map.density.end());
+        auto ms = [](std::chrono::steady_clock::duration d) { return std::to_string(std::chrono::duration<double>(d).count() * 1000); };
+        LogFusion("[ThickLine] Coverage of sketch '" + sk->name() + "': " + std::to_string(outlines.size()) + " outlines, " +
+                  std::to_string(map.cols) + " x " + std::to_string(map.rows) + " tiles, " +
+                  "covered " + std::to_string(map.coveredCm2 * 100) + " mm^2, tile density " + std::to_string(lo) + " .. " + std::to_string(hi) +
+                  " (index " + ms(t1 - t0) + " ms, raster " + ms(t2 - t1) + " ms)" +
+                  (written ? "\n  written to: " + csv.string() + "\n  heatmap: " + bmp.string() : std::string("\n  could not write the results.")));
+    }
+} _thickLineCoverageCommandHandler;
+
+class ThickLineCoverageCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        if (!inputs)
+            return;
+        ThickLineSettings S = loadSettingsIni();
+        Ptr<ValueCommandInput> tile = inputs->addValueInput(kCoverageTileId, "Tile size", "mm", ValueInput::createByReal(S.coverageTile_cm));
+        tile->minimumValue(0.0);
+        tile->tooltip("Side of the square tiles the coverage is reported for");
+        Ptr<IntegerSpinnerCommandInput> samples = inputs->addIntegerSpinnerCommandInput(kCoverageSamplesId, "Samples per tile", 1, 1024, 1, S.coverageSamples);
+        samples->tooltip("Raster samples along a tile side (anti-aliased, so few are needed for an exact area)");
+
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLineCoverageCommandHandler);
+    }
+} _thickLineCoverageCommandCreatedHandler;
+
+// ---- Sharded DXF export ----
+// Large panels are written by several workers: the outlines are split into spatial shards (STR
+// order: stripes by x, cells by y, ties by index), every worker writes its shards to part files
+// through a buffer of bounded size, and the parts are joined in shard order between one header and
+// footer, so the file is identical for any thread count. Workers are threads, not processes: the
+// add-in lives inside Fusion, which must not be forked.
+
+static const char* kDxfExportCmdId = "habiThickLineDxfExport";
+
+// Outlines per shard
+constexpr size_t kDxfShardOutlines = 20000;
+
+// Outline as DXF R12 entities (mm): a closed polyline with bulges for the arcs, or a circle
+inline void appendDxfOutline(const Outline& o, std::vector<OutlineSeg>& segs, std::string& out)
+{
+    char buf[64];
+    auto put = [&](int code, double v) {
+        snprintf(buf, sizeof(buf), "%d\n%.6f\n", code, v);
+        out += buf;
+    };
+    if (o.circleR > 0 && !o.pts.empty()) {
+        out += "0\nCIRCLE\n8\nTHICKLINE\n";
+        put(10, o.pts[0].x * 10);
+        put(20, o.pts[0].y * 10);
+        put(40, o.circleR * 10);
+        return;
+    }
+    if (o.pts.size() < 3)
+        return;
+    outlineSegments(o, segs);
+    out += "0\nPOLYLINE\n8\nTHICKLINE\n66\n1\n10\n0.0\n20\n0.0\n30\n0.0\n70\n1\n";
+    for (const OutlineSeg& g : segs) {
+        out += "0\nVERTEX\n8\nTHICKLINE\n";
+        put(10, g.a.x * 10);
+        put(20, g.a.y * 10);
+        V2 chord = vsub(g.b, g.a);
+        double c2 = vdot(chord, chord);
+        if (g.arc && c2 > 0)
+            put(42, -2 * vcross(chord, vsub(g.mid, g.a)) / c2); // tan(angle / 4), > 0 counter-clockwise
+    }
+    out += "0\nSEQEND\n8\nTHICKLINE\n";
+}
 
-		// Half width vector
-        V2 wHalf = vscale(P.Wdir, P.widthCm * 0.5);
+struct DxfExportStats {
+    size_t outlines = 0;
+    size_t shards = 0;
+    uintmax_t bytes = 0;
+};
 
-        // --- main rectangle spans Abase <-> Bbase (skip if inverted/zero) ---
-        V2 seg = vsub(P.Bbase, P.Abase);
+inline bool writeShardedDxf(const std::filesystem::path& path, const std::vector<Outline>& outlines, unsigned threads,
+                            size_t budgetBytes, DxfExportStats& stats, std::string& err)
+{
+    stats = DxfExportStats();
+    std::vector<Box2> boxes(outlines.size());
+    Box2 all;
+    std::vector<uint32_t> order;
+    order.reserve(outlines.size());
+    for (size_t i = 0; i < outlines.size(); ++i) {
+        boxes[i] = outlineBox(outlines[i]);
+        if (boxes[i].empty())
+            continue; // vanished by compensation
+        all.add(boxes[i]);
+        order.push_back((uint32_t)i);
+    }
+    if (order.empty()) {
+        err = "No thick lines to export.";
+        return false;
+    }
 
-        V2 Aplus = vadd(P.Abase, wHalf);
-        V2 Aminus = vsub(P.Abase, wHalf);
-        V2 Bplus = vadd(P.Bbase, wHalf);
-        V2 Bminus = vsub(P.Bbase, wHalf);
+    // spatial shards: [shardStart[k], shardStart[k + 1]) of order
+    const size_t n = order.size();
+    const size_t shards = (n + kDxfShardOutlines - 1) / kDxfShardOutlines;
+    const size_t stripes = (size_t)std::ceil(std::sqrt((double)shards));
+    const size_t perStripe = (n + stripes - 1) / stripes;
+    auto byX = [&](uint32_t a, uint32_t b) { double ca = boxes[a].x0 + boxes[a].x1, cb = boxes[b].x0 + boxes[b].x1; return ca < cb || (ca == cb && a < b); };
+    auto byY = [&](uint32_t a, uint32_t b) { double ca = boxes[a].y0 + boxes[a].y1, cb = boxes[b].y0 + boxes[b].y1; return ca < cb || (ca == cb && a < b); };
+    std::sort(order.begin(), order.end(), byX);
+    std::vector<size_t> shardStart;
+    for (size_t s = 0; s < n; s += perStripe) {
+        size_t end = std::min(n, s + perStripe);
+        std::sort(order.begin() + s, order.begin() + end, byY);
+        for (size_t c = s; c < end; c += kDxfShardOutlines)
+            shardStart.push_back(c);
+    }
+    shardStart.push_back(n);
+    stats.outlines = n;
+    stats.shards = shardStart.size() - 1;
 
-		drawThreePointRect(P.sketch, Aplus, Bplus, Aminus); // ensures corners are closed
+    // the parts go to a new directory of our own in the temp folder, so cleaning up can't touch
+    // anything of the user's
+    std::error_code ec;
+    std::filesystem::path tmp;
+    const std::filesystem::path tmpRoot = std::filesystem::temp_directory_path(ec);
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    for (unsigned attempt = 0; !ec && tmp.empty() && attempt < 100; ++attempt) {
+        std::filesystem::path dir = tmpRoot / ("thickline_dxf_" + std::to_string(stamp) + "_" + std::to_string(attempt));
+        if (std::filesystem::create_directory(dir, ec))
+            tmp = dir;
+    }
+    if (tmp.empty()) {
+        err = "Cannot create a temporary folder for the DXF export.";
+        return false;
+    }
+    auto partPath = [&](size_t k) { return tmp / ("shard_" + std::to_string(k) + ".part"); };
 
-        // --- feature at A (tip fixed at Aext, depth = aLuse) ---
-        if (P.featAType == "Arrow") {
-            V2 aSide = vscale(P.Wdir, P.featAWCm * 0.5);
-            V2 baseL = vadd(P.Abase, aSide);
-            V2 baseR = vadd(P.Abase, vscale(aSide, -1.0));
-            drawTriangle(P.sketch, baseL, P.Aext, baseR);
+    std::vector<char> written(stats.shards, 0);
+    parallelChunks(stats.shards, 1, threads, [&](size_t k, size_t, size_t)
+    {
+        std::ofstream part(partPath(k), std::ios::binary | std::ios::trunc);
+        std::string buf;
+        std::vector<OutlineSeg> segs;
+        for (size_t i = shardStart[k]; i < shardStart[k + 1] && part; ++i) {
+            appendDxfOutline(outlines[order[i]], segs, buf);
+            if (buf.size() >= budgetBytes) {
+                part.write(buf.data(), (std::streamsize)buf.size());
+                buf.clear();
+            }
         }
-        else if (P.featAType == "T") {
-            V2 aSide = vscale(P.Wdir, P.featAWCm * 0.5);
-            V2 aL0 = vadd(P.Abase, aSide);
-            V2 aR0 = vadd(P.Abase, vscale(aSide, -1.0));
-            V2 aL1 = vadd(aL0, vscale(P.Ldir, -P.featALCm)); // toward Aext
-            V2 aR1 = vadd(aR0, vscale(P.Ldir, -P.featALCm));
-			drawThreePointRect(P.sketch, aL0, aL1, aR0); // ensure corners are closed
+        part.write(buf.data(), (std::streamsize)buf.size());
+        written[k] = part ? 1 : 0;
+    });
+
+    // header, the parts in shard order, footer; into a temporary file that replaces the target
+    // only once it is complete, so a failed export leaves an existing file alone
+    bool ok = std::find(written.begin(), written.end(), 0) == written.end();
+    std::filesystem::path outTmp = path;
+    outTmp += ".tmp";
+    if (ok) {
+        std::ofstream out(outTmp, std::ios::binary | std::ios::trunc);
+        char buf[256];
+        snprintf(buf, sizeof(buf), "999\nThick Line export, mm\n0\nSECTION\n2\nHEADER\n9\n$ACADVER\n1\nAC1009\n"
+                 "9\n$EXTMIN\n10\n%.6f\n20\n%.6f\n9\n$EXTMAX\n10\n%.6f\n20\n%.6f\n0\nENDSEC\n0\nSECTION\n2\nENTITIES\n",
+                 all.x0 * 10, all.y0 * 10, all.x1 * 10, all.y1 * 10);
+        out << buf;
+        std::vector<char> block(1 << 20);
+        for (size_t k = 0; k < stats.shards && out; ++k) {
+            std::ifstream in(partPath(k), std::ios::binary);
+            if (!in)
+                out.setstate(std::ios::failbit);
+            while (in) {
+                in.read(block.data(), (std::streamsize)block.size());
+                out.write(block.data(), in.gcount());
+            }
+        }
+        out << "0\nENDSEC\n0\nEOF\n";
+        out.close();
+        ok = (bool)out;
+        if (ok) {
+            std::filesystem::rename(outTmp, path, ec);
+            ok = !ec;
         }
+        if (!ok)
+            std::filesystem::remove(outTmp, ec);
+        stats.bytes = ok ? std::filesystem::file_size(path, ec) : 0;
+    }
+    for (size_t k = 0; k < stats.shards; ++k)
+        std::filesystem::remove(partPath(k), ec);
+    std::filesystem::remove(tmp, ec); // only when empty
+    if (!ok)
+        err = "Cannot write " + path.u8string() + ".";
+    return ok;
+}
 
-        // --- feature at B (tip fixed at Bext, depth = bLuse) ---
-        if (P.featBType == "Arrow") {
-            V2 bSide = vscale(P.Wdir, P.featBWCm * 0.5);
-            V2 baseL = vadd(P.Bbase, bSide);
-            V2 baseR = vadd(P.Bbase, vscale(bSide, -1.0));
-            drawTriangle(P.sketch, baseL, P.Bext, baseR);
+class ThickLineDxfExportCommandHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Sketch> sk = getActiveSketch();
+        if (!sk) {
+            LogFusion("[ThickLine] DXF export: open a sketch first.");
+            return;
         }
-        else if (P.featBType == "T") {
-            V2 bSide = vscale(P.Wdir, P.featBWCm * 0.5);
-            V2 bL0 = vadd(P.Bbase, bSide);
-            V2 bR0 = vadd(P.Bbase, vscale(bSide, -1.0));
-            V2 bL1 = vadd(bL0, vscale(P.Ldir, +P.featBLCm)); // toward Bext
-            V2 bR1 = vadd(bR0, vscale(P.Ldir, +P.featBLCm));
-			drawThreePointRect(P.sketch, bL0, bL1, bR0); // ensure corners are closed
+        Ptr<FileDialog> dlg = _ui->createFileDialog();
+        if (!dlg)
+            return;
+        dlg->title("Export Thick Lines as DXF");
+        dlg->filter("DXF files (*.dxf)");
+        if (dlg->showSave() != DialogOK)
+            return;
+
+        auto t0 = std::chrono::steady_clock::now();
+        ThickLineSettings S = loadSettingsIni();
+        SketchIndex* index = sketchIndex(sk, S.workerThreads);
+        if (!index)
+            return;
+        std::vector<Outline> outlines;
+        outlines.reserve(index->outlines.size());
+        for (size_t i = 0; i < index->outlines.size(); ++i)
+            if (!index->dead[index->outlineRecord[i]])
+                outlines.push_back(index->outlines[i]);
+        compensateOutlines(outlines, S, OutputTarget::Export);
+
+        DxfExportStats stats;
+        std::string err;
+        if (!writeShardedDxf(std::filesystem::u8path(dlg->filename()), outlines, S.workerThreads,
+                             (size_t)std::max(1, S.exportShardBudgetMB) << 20, stats, err)) {
+            LogFusion("[ThickLine] DXF export: " + err);
+            return;
         }
+        LogFusion("[ThickLine] Exported " + std::to_string(stats.outlines) + " outlines in " + std::to_string(stats.shards) +
+                  " shard(s), " + std::to_string(stats.bytes) + " bytes, in " +
+                  std::to_string(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() * 1000) + " ms.");
+    }
+} _thickLineDxfExportCommandHandler;
 
-		ThickLineSettings S;
-		S.width_cm = P.widthCm;
-		S.leadA_cm = P.leadACm;
-		S.featAType = P.featAType;
-		S.featAL_cm = P.featALCm;
-		S.featAW_cm = P.featAWCm;
-        S.leadB_cm = P.leadBCm;
-        S.featBType = P.featBType;
-        S.featBL_cm = P.featBLCm;
-		S.featBW_cm = P.featBWCm;
-        saveSettingsIni(S); // save current settings
+class ThickLineDxfExportCommandCreatedHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        if (!cmd)
+            return;
+        cmd->isAutoExecute(true);
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLineDxfExportCommandHandler);
+    }
+} _thickLineDxfExportCommandCreatedHandler;
 
-		LogFusion("[ThickLine] Settings saved to: " + settingsPath().string());
+// Time from the button click to a usable dialog: the phases of building it, and the wait until
+// Fusion activates the command (dialog shown), logged once activated
+struct DialogTimer {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now(), last = t0;
+    std::string phases;
+
+    void lap(const char* name)
+    {
+        auto now = std::chrono::steady_clock::now();
+        phases += std::string(phases.empty() ? "" : ", ") + name + " " + std::to_string(std::chrono::duration<double>(now - last).count() * 1000) + " ms";
+        last = now;
     }
-} _thickLineCommandHandler;
+};
+
+static DialogTimer g_DialogOpen;
+
+class ThickLineActivateEventHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        if (g_DialogOpen.phases.empty())
+            return;
+        g_DialogOpen.lap("until shown");
+        LogFusion("[ThickLine] Dialog open in " +
+                  std::to_string(std::chrono::duration<double>(g_DialogOpen.last - g_DialogOpen.t0).count() * 1000) + " ms (" + g_DialogOpen.phases + ")");
+        g_DialogOpen = DialogTimer(); // empty: log once per dialog
+    }
+} _thickLineActivateHandler;
 
 class ThickLineCommandCreatedEventHandler : public CommandCreatedEventHandler
 {
 public:
     void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
     {
+        DialogTimer dialogTimer;
 		// Load settings from INI file (or use default values)
         ThickLineSettings S = loadSettingsIni();
+        g_OccTransforms.clear(); // occurrences may have moved since the last command
+        dialogTimer.lap("settings");
 
         // Get the command from the event arguments.
 		Ptr<Command> cmd = eventArgs->command();
@@ -641,14 +5475,28 @@ public:
         // Graphic
         Ptr<ImageCommandInput> img = inputs->addImageCommandInput(kGraphic, "", "Resources/Graphic200.png");
         img->isFullWidth(true); // make it stretch across the dialog
+        dialogTimer.lap("image");
 
         // Separator under image
         inputs->addSeparatorCommandInput(kSeparator1);
 
+        // ---- Mode (global) ----
+        Ptr<DropDownCommandInput> modeInput = inputs->addDropDownCommandInput(kModeId, "Mode", DropDownStyles::TextListDropDownStyle);
+        modeInput->listItems()->add("Single line", S.mode != "Hub" && S.mode != "Sweep" && S.mode != "Chain");
+        modeInput->listItems()->add("Hub and spokes", S.mode == "Hub");
+        modeInput->listItems()->add("Sweep", S.mode == "Sweep");
+        modeInput->listItems()->add("Chain", S.mode == "Chain");
+        modeInput->tooltip("Hub and spokes: A is the hub, select any number of B points; the spokes share one junction (Feature A = Pad adds a pad). Chain: A, then the B points in selection order, as one route");
+
         // ---- Width (global) ----
         Ptr<ValueCommandInput> widthInput = inputs->addValueInput(kWidthId, "Width", "mm", ValueInput::createByReal(S.width_cm));
 		widthInput->minimumValue(0.0);
 
+        // ---- Cap fillet (global) ----
+        Ptr<ValueCommandInput> filletInput = inputs->addValueInput(kCapFilletId, "Cap Fillet", "mm", ValueInput::createByReal(S.capFillet_cm));
+        filletInput->minimumValue(0.0);
+        filletInput->tooltip("Tangent arc radius where the line meets an Arrow or T feature, and at the outer corners of a chain (0 = sharp corners)");
+
         // Separator under image
         inputs->addSeparatorCommandInput(kSeparator2);
 
@@ -677,6 +5525,7 @@ public:
             itemsA->add("None", S.featAType == "None");
             itemsA->add("Arrow", S.featAType == "Arrow");
             itemsA->add("T", S.featAType == "T");
+            itemsA->add("Pad", S.featAType == "Pad"); // hub and spokes mode only
 
             // Feature A Width / Length
             Ptr<ValueCommandInput> aW = giA->addValueInput(kFeatAWidthId, "Feature A Width", "mm", ValueInput::createByReal(S.featAW_cm));
@@ -713,6 +5562,25 @@ public:
             bL->isEnabled(false);
         }
 
+        // ---- Direction markers (collapsed, rarely used) ----
+        Ptr<GroupCommandInput> grpM = inputs->addGroupCommandInput(kGroupMarkers, "Direction Markers");
+        grpM->isExpanded(S.markerSpacing_cm > 0);
+        if (grpM->isExpanded())
+            addMarkerInputs(grpM->children(), S);
+
+        // ---- Sweep (sweep mode only, filled by updateModeInputs) ----
+        Ptr<GroupCommandInput> grpS = inputs->addGroupCommandInput(kGroupSweep, "Sweep");
+        grpS->isExpanded(true);
+        grpS->isVisible(false);
+        grpS->tooltip("Every size goes from its value above to 'To' in 'Steps' steps; all combinations are laid out in a grid");
+
+        // ---- Extrude (collapsed unless used last time) ----
+        Ptr<GroupCommandInput> grpE = inputs->addGroupCommandInput(kGroupExtrude, "Extrude");
+        grpE->isExpanded(S.extrude);
+        if (grpE->isExpanded())
+            addExtrudeInputs(grpE->children(), S);
+        dialogTimer.lap("inputs");
+
 		Ptr<TextBoxCommandInput> errorBox = inputs->addTextBoxCommandInput(kErrorBox, "", "", 2, true);
 		errorBox->isFullWidth(true);
         errorBox->isVisible(false); // hidden by default
@@ -736,12 +5604,489 @@ public:
 		if (!commandEvent->add(&_thickLineCommandHandler))
 			return;
 
+		// Preview with level of detail, refreshed when zooming changes the level
+		Ptr<CommandEvent> previewEvent = cmd->executePreview();
+		if (previewEvent)
+			previewEvent->add(&_thickLinePreviewHandler);
+		Ptr<CommandEvent> destroyEvent = cmd->destroy();
+		if (destroyEvent)
+			destroyEvent->add(&_thickLineDestroyHandler);
+		Ptr<CameraEvent> cameraEvent = _app->cameraChanged();
+		if (cameraEvent)
+			cameraEvent->add(&_thickLineCameraChangedHandler);
+		Ptr<CommandEvent> activateEvent = cmd->activate();
+		if (activateEvent)
+			activateEvent->add(&_thickLineActivateHandler);
+
         // Initial pass so defaults match the selected items when the dialog opens
+        updateModeInputs(inputs);
         updateFeatureInputs(inputs, kFeatATypeId, kFeatAWidthId, kFeatALengthId);
         updateFeatureInputs(inputs, kFeatBTypeId, kFeatBWidthId, kFeatBLengthId);
+        dialogTimer.lap("handlers");
+        g_DialogOpen = dialogTimer;
     }
 } _thickLineCommandCreatedHandler;
 
+#ifdef THICKLINE_BENCH
+// ---- Benchmark command (only in builds with THICKLINE_BENCH defined) ----
+// Emits a synthetic batch into the active sketch with every emit strategy and reports the
+// measured wall time next to the time projected by the cost model. Use a scratch sketch.
+
+static const char* kBenchCmdId = "habiThickLineBench";
+static const char* kBenchCountId = "tlb_count";
+static const char* kBenchKindId = "tlb_kind";
+static const char* kBenchSeedId = "tlb_seed";
+
+// ---- Synthetic workloads ----
+// Seeded, reproducible thick-line sets that look like real designs. The random numbers come
+// straight from mt19937 (exactly specified by the standard) rather than std distributions,
+// whose output differs between standard libraries, so a seed gives the same batch everywhere.
+
+enum class WorkloadKind { Grid = 0, RandomWalk, Star, Meander, Count };
+
+inline const char* workloadName(WorkloadKind k)
+{
+    switch (k) {
+    case WorkloadKind::RandomWalk: return "Random walk routes";
+    case WorkloadKind::Star:       return "Stars";
+    case WorkloadKind::Meander:    return "Meanders";
+    default:                       return "Grid";
+    }
+}
+
+struct WorkloadSpec {
+    WorkloadKind kind = WorkloadKind::Grid;
+    int count = 200;                  // number of thick lines
+    uint32_t seed = 1;
+    double shortFraction = 0.3;       // dense short segments (0.1 - 0.5 cm)
+    double busFraction = 0.1;         // long buses (5 - 20 cm)
+    double degenerateFraction = 0.05; // barely longer than their leads and features
+};
+
+class WorkloadRng
+{
+public:
+    explicit WorkloadRng(uint32_t seed) : mt_(seed) {}
+    double uniform(double lo, double hi) { return lo + (hi - lo) * ((double)mt_() / 4294967296.0); }
+    int pick(int n) { return (int)(mt_() % (uint32_t)n); }
+    bool chance(double p) { return uniform(0.0, 1.0) < p; }
+private:
+    std::mt19937 mt_;
+};
+
+// Random sizes and caps for one line; the B point is set by the caller
+inline void randomLineStyle(WorkloadRng& rng, ThickLineParams& P)
+{
+    static const char* caps[] = { "None", "Arrow", "T" };
+    P.widthCm = rng.uniform(0.05, 0.5);
+    P.leadACm = rng.chance(0.2) ? rng.uniform(0.0, 0.2) : 0.0;
+    P.leadBCm = rng.chance(0.2) ? rng.uniform(0.0, 0.2) : 0.0;
+    P.featAType = caps[rng.pick(3)];
+    P.featBType = caps[rng.pick(3)];
+    P.featAWCm = P.featAType != "None" ? P.widthCm * rng.uniform(1.0, 3.0) : 0.0;
+    P.featALCm = P.featAType != "None" ? rng.uniform(0.05, 0.3) : 0.0;
+    P.featBWCm = P.featBType != "None" ? P.widthCm * rng.uniform(1.0, 3.0) : 0.0;
+    P.featBLCm = P.featBType != "None" ? rng.uniform(0.05, 0.3) : 0.0;
+    P.capFilletCm = rng.chance(0.2) ? rng.uniform(0.005, 0.05) : 0.0;
+}
+
+// Segment length drawn from the spec's mix (normal, dense short, long bus, near-degenerate)
+inline double randomLength(WorkloadRng& rng, const WorkloadSpec& spec, const ThickLineParams& P)
+{
+    const double minLen = P.featALCm + P.featBLCm - P.leadACm - P.leadBCm;
+    double r = rng.uniform(0.0, 1.0);
+    if (r < spec.degenerateFraction)
+        return std::max(minLen, 0.0) + 1e3 * kEpsSketchLen;
+    r -= spec.degenerateFraction;
+    double len = r < spec.shortFraction ? rng.uniform(0.1, 0.5)
+               : r < spec.shortFraction + spec.busFraction ? rng.uniform(5.0, 20.0)
+               : rng.uniform(0.5, 3.0);
+    return std::max(len, minLen + 0.01);
+}
+
+// Generate the thick lines of a workload (all valid for validateParams)
+inline std::vector<ThickLineParams> makeWorkload(const WorkloadSpec& spec)
+{
+    std::vector<ThickLineParams> lines;
+    lines.reserve((size_t)std::max(spec.count, 0));
+    WorkloadRng rng(spec.seed);
+    std::string err;
+
+    const double kPi = 3.14159265358979323846;
+    V2 pos = v2(0, 0);     // current point of a route / hub of a star
+    double heading = 0;    // current direction of a route (radians)
+    int run = 0;           // segments left in the current route, star or meander row
+
+    while ((int)lines.size() < spec.count)
+    {
+        ThickLineParams P;
+        randomLineStyle(rng, P);
+        double len = randomLength(rng, spec, P);
+        int i = (int)lines.size();
+
+        switch (spec.kind)
+        {
+        case WorkloadKind::Grid: {
+            // horizontal and vertical runs on a 4 cm pitch
+            const int cols = 25;
+            V2 cell = v2((i / 2 % cols) * 4.0, (i / 2 / cols) * 4.0);
+            V2 dir = (i % 2) ? v2(0, 1) : v2(1, 0);
+            P.A = cell;
+            P.B = vadd(cell, vscale(dir, std::min(len, 3.5)));
+            break;
+        }
+        case WorkloadKind::RandomWalk: {
+            // routes of 5 - 40 segments turning in steps of 45 degrees
+            if (run-- <= 0) {
+                run = 5 + rng.pick(36);
+                pos = v2(rng.uniform(0, 200), rng.uniform(0, 200));
+                heading = rng.pick(8) * kPi / 4;
+            }
+            else
+                heading += (rng.pick(3) - 1) * kPi / 4;
+            P.A = pos;
+            P.B = vadd(pos, v2(len * std::cos(heading), len * std::sin(heading)));
+            pos = P.B;
+            break;
+        }
+        case WorkloadKind::Star: {
+            // hubs with 3 - 24 spokes at random angles
+            if (run-- <= 0) {
+                run = 3 + rng.pick(22);
+                pos = v2(rng.uniform(0, 200), rng.uniform(0, 200));
+            }
+            double a = rng.uniform(0, 2 * kPi);
+            P.A = pos;
+            P.B = vadd(pos, v2(len * std::cos(a), len * std::sin(a)));
+            break;
+        }
+        case WorkloadKind::Meander: {
+            // serpentine: long rows joined by short steps
+            if (run-- <= 0) {
+                run = 20 + rng.pick(40);
+                pos = v2(rng.uniform(0, 200), rng.uniform(0, 200));
+                heading = 0;
+            }
+            bool row = (run % 2) == 0;
+            V2 d = row ? v2(heading == 0 ? 1 : -1, 0) : v2(0, 1);
+            double l = row ? std::max(len, 4.0) : std::max(P.featALCm + P.featBLCm + 0.05, 0.3);
+            P.A = pos;
+            P.B = vadd(pos, vscale(d, l));
+            pos = P.B;
+            if (row) heading = heading == 0 ? 1 : 0;
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (computeDerived(P, err) && validateParams(P, err))
+            lines.push_back(P);
+    }
+    return lines;
+}
+
+// Synthetic batch: outlines of a workload
+inline std::vector<Outline> makeSyntheticBatch(const WorkloadSpec& spec, unsigned threads)
+{
+    std::vector<Outline> outlines;
+    buildBatchOutlines(makeWorkload(spec), outlines, threads);
+    return outlines;
+}
+
+// True when two outline sets are bit-identical
+inline bool sameOutlines(const std::vector<Outline>& a, const std::vector<Outline>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].isRect != b[i].isRect || a[i].pts.size() != b[i].pts.size() || a[i].fillet != b[i].fillet || a[i].circleR != b[i].circleR)
+            return false;
+        if (!a[i].pts.empty() && std::memcmp(a[i].pts.data(), b[i].pts.data(), a[i].pts.size() * sizeof(V2)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Hardware performance counters around a benchmark phase. Read through perf_event on Linux when
+// THICKLINE_PERF is set in the environment; unavailable on other platforms.
+class HwCounters
+{
+public:
+    enum { Cycles, Instructions, CacheMisses, BranchMisses, Count };
+
+    static const char* name(int i)
+    {
+        static const char* names[Count] = { "cycles", "instructions", "cache misses", "branch misses" };
+        return names[i];
+    }
+
+    HwCounters()
+    {
+#if defined(__linux__)
+        if (!std::getenv("THICKLINE_PERF"))
+            return;
+        const uint64_t configs[Count] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                          PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        for (int i = 0; i < Count; ++i) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = i == 0 ? 1 : 0; // the group leader starts and stops all
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fd_[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fd_[0], 0);
+            if (fd_[i] < 0) {
+                close();
+                return;
+            }
+        }
+#endif
+    }
+
+    ~HwCounters() { close(); }
+
+    bool available() const { return fd_[0] >= 0; }
+
+    void start()
+    {
+#if defined(__linux__)
+        if (!available())
+            return;
+        ioctl(fd_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fd_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    void stop()
+    {
+#if defined(__linux__)
+        if (!available())
+            return;
+        ioctl(fd_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t buf[1 + Count] = {}; // nr, then one value per counter
+        if (read(fd_[0], buf, sizeof(buf)) == (ssize_t)sizeof(buf))
+            for (int i = 0; i < Count; ++i)
+                values_[i] = buf[1 + i];
+#endif
+    }
+
+    uint64_t value(int i) const { return values_[i]; }
+
+private:
+    void close()
+    {
+#if defined(__linux__)
+        for (int& fd : fd_) {
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+        }
+#endif
+    }
+
+    int fd_[Count] = { -1, -1, -1, -1 };
+    uint64_t values_[Count] = {};
+};
+
+// Benchmark gate: per-line figures of a run must not exceed the recorded baseline by more than this
+constexpr double kBenchGateTolerance = 1.10;
+
+inline std::filesystem::path benchBaselinePath()
+{
+    return appDataDir() / "bench_baseline.ini";
+}
+
+// Check per-line figures against the baseline (recording them when new); false on regression
+inline bool benchGate(std::map<std::string, double>& baseline, const std::string& key, double perLine, std::ostringstream& rep)
+{
+    auto it = baseline.find(key);
+    if (it == baseline.end()) {
+        baseline[key] = perLine;
+        return true;
+    }
+    if (perLine <= it->second * kBenchGateTolerance + 1e-9)
+        return true;
+    rep << "  REGRESSION " << key << ": " << perLine << " per line (baseline " << it->second << ")\n";
+    return false;
+}
+
+class ThickLineBenchCommandEventHandler : public CommandEventHandler
+{
+public:
+    void notify(const Ptr<CommandEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        Ptr<Sketch> sketch = getActiveSketch();
+        if (!inputs || !sketch)
+        {
+            LogFusion("[ThickLine] Benchmark needs an active sketch.\n");
+            return;
+        }
+
+        Ptr<IntegerSpinnerCommandInput> countIn = inputs->itemById(kBenchCountId)->cast<IntegerSpinnerCommandInput>();
+        Ptr<DropDownCommandInput> kindIn = inputs->itemById(kBenchKindId)->cast<DropDownCommandInput>();
+        Ptr<IntegerSpinnerCommandInput> seedIn = inputs->itemById(kBenchSeedId)->cast<IntegerSpinnerCommandInput>();
+        WorkloadSpec spec;
+        spec.count = countIn ? countIn->value() : 100;
+        spec.kind = (kindIn && kindIn->selectedItem()) ? (WorkloadKind)kindIn->selectedItem()->index() : WorkloadKind::Grid;
+        spec.seed = seedIn ? (uint32_t)seedIn->value() : 1;
+        const int count = spec.count;
+        const double lines = (double)(count > 0 ? count : 1);
+
+        // baseline of the perf gate (key=value)
+        std::map<std::string, double> baseline;
+        {
+            std::ifstream bf(benchBaselinePath());
+            std::string line;
+            while (std::getline(bf, line)) {
+                auto pos = line.find('=');
+                if (pos != std::string::npos)
+                    try { baseline[line.substr(0, pos)] = std::stod(line.substr(pos + 1)); } catch (...) {}
+            }
+        }
+        bool gateOk = true;
+
+        std::ostringstream rep;
+        rep << std::fixed << std::setprecision(1);
+
+        // settings and workload first: only the outline build itself is counted
+        ThickLineSettings S = loadSettingsIni();
+        const std::vector<ThickLineParams> workload = makeWorkload(spec);
+
+        HwCounters hw;
+        std::vector<Outline> outlines;
+        size_t buildAllocCount = 0, buildAllocBytes = 0;
+        {
+            AllocCounter allocs;
+            hw.start();
+            buildBatchOutlines(workload, outlines, S.workerThreads);
+            hw.stop();
+            buildAllocCount = allocs.count();
+            buildAllocBytes = allocs.bytes();
+        }
+        rep << "ThickLine emit benchmark: " << workloadName(spec.kind) << " (seed " << spec.seed << "), "
+            << count << " lines, " << outlines.size() << " outlines\n";
+        rep << "  build: " << buildAllocCount / lines << " allocs, " << buildAllocBytes / lines << " bytes per line\n";
+        if (hw.available()) {
+            rep << "    per line:";
+            for (int i = 0; i < HwCounters::Count; ++i)
+                rep << " " << (double)hw.value(i) / lines << " " << HwCounters::name(i) << (i + 1 < HwCounters::Count ? "," : "\n");
+        }
+        gateOk &= benchGate(baseline, "build_allocs", buildAllocCount / lines, rep);
+
+        // parallel building must give the same bits as a single thread
+        bool deterministic = sameOutlines(outlines, makeSyntheticBatch(spec, 1));
+        rep << "  parallel build identical to single-threaded: " << (deterministic ? "yes" : "NO") << "\n";
+        gateOk &= deterministic;
+
+        for (int s = 0; s < (int)EmitStrategy::Count; ++s)
+            for (int defer = 0; defer < 2; ++defer)
+            {
+                EmitOptions opt{ (EmitStrategy)s, defer != 0 };
+                const std::string name = std::string(emitStrategyName(opt.strategy)) + (opt.deferFix ? "_deferred" : "_perLine");
+                int bucket = sketchSizeBucket(sketch->sketchCurves()->count());
+                double projected = S.cost.projectSeconds(bucket, countEmitCalls(outlines, opt));
+
+                ApiCallTally tally;
+                std::vector<Ptr<SketchCurve>> created;
+                AllocCounter allocs;
+                auto t0 = std::chrono::steady_clock::now();
+                {
+                    SketchEmitter emitter(sketch, opt, &tally);
+                    for (const Outline& o : outlines)
+                        emitter.emit(o);
+                    emitter.finish();
+                    created = emitter.created();
+                }
+                double measured = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                const size_t allocCount = allocs.count();
+                const size_t allocBytes = allocs.bytes();
+                S.cost.observe(bucket, tally);
+
+                rep << "  " << name << ": measured " << measured * 1000.0 << " ms, projected " << projected * 1000.0 << " ms\n"
+                    << "    per line: " << tally.totalCalls() / lines << " API calls (";
+                for (int c = 0; c < (int)ApiCall::Count; ++c)
+                    if (tally.calls[c])
+                        rep << apiCallName((ApiCall)c) << " " << tally.calls[c] / lines << " ";
+                rep << "), " << allocCount / lines << " allocs, " << allocBytes / lines << " bytes\n";
+
+                gateOk &= benchGate(baseline, name + "_calls", tally.totalCalls() / lines, rep);
+                gateOk &= benchGate(baseline, name + "_allocs", allocCount / lines, rep);
+
+                // remove the batch again (untimed) so every run starts from the same sketch
+                for (const Ptr<SketchCurve>& c : created)
+                    if (c) c->deleteMe();
+            }
+
+        // record new baseline keys (existing ones are only changed by deleting the file)
+        {
+            std::ofstream bf(benchBaselinePath(), std::ios::trunc);
+            for (const auto& kv : baseline)
+                bf << kv.first << "=" << kv.second << "\n";
+        }
+        rep << (gateOk ? "Perf gate: passed\n" : "Perf gate: FAILED\n");
+
+        saveSettingsIni(S); // keep the refined cost model
+        LogFusion(rep.str());
+        if (_ui) _ui->messageBox(rep.str(), "ThickLine Benchmark", MessageBoxButtonTypes::OKButtonType,
+            gateOk ? MessageBoxIconTypes::InformationIconType : MessageBoxIconTypes::WarningIconType);
+    }
+} _thickLineBenchCommandHandler;
+
+class ThickLineBenchCommandCreatedEventHandler : public CommandCreatedEventHandler
+{
+public:
+    void notify(const Ptr<CommandCreatedEventArgs>& eventArgs) override
+    {
+        Ptr<Command> cmd = eventArgs->command();
+        Ptr<CommandInputs> inputs = cmd ? cmd->commandInputs() : nullptr;
+        if (!inputs)
+            return;
+
+        inputs->addIntegerSpinnerCommandInput(kBenchCountId, "Lines", 1, 100000, 10, 200);
+
+        Ptr<DropDownCommandInput> kind = inputs->addDropDownCommandInput(kBenchKindId, "Workload", DropDownStyles::TextListDropDownStyle);
+        for (int k = 0; k < (int)WorkloadKind::Count; ++k)
+            kind->listItems()->add(workloadName((WorkloadKind)k), k == 0);
+
+        inputs->addIntegerSpinnerCommandInput(kBenchSeedId, "Seed", 0, 1000000, 1, 1);
+
+        Ptr<CommandEvent> commandEvent = cmd->execute();
+        if (commandEvent)
+            commandEvent->add(&_thickLineBenchCommandHandler);
+    }
+} _thickLineBenchCommandCreatedHandler;
+#endif // THICKLINE_BENCH
+
+// Add a button to a panel and connect its command created handler
+inline bool addPanelCommand(const Ptr<ToolbarPanel>& panel, const std::string& id, const std::string& name,
+                            const std::string& tooltip, CommandCreatedEventHandler* handler, bool promote = false)
+{
+    Ptr<CommandDefinition> def = _ui->commandDefinitions()->addButtonDefinition(id, name, tooltip, "Resources/Icons");
+    if (!def || !panel)
+        return false;
+    Ptr<CommandControl> button = panel->controls()->addCommand(def);
+    if (!button)
+        return false;
+    if (promote)
+        button->isPromoted(true);
+    Ptr<CommandCreatedEvent> created = def->commandCreated();
+    return created && created->add(handler);
+}
+
+inline void removePanelCommand(const Ptr<ToolbarPanel>& panel, const std::string& id)
+{
+    Ptr<CommandControl> button = panel ? panel->controls()->itemById(id) : nullptr;
+    if (button)
+        button->deleteMe();
+    Ptr<CommandDefinition> def = _ui->commandDefinitions()->itemById(id);
+    if (def)
+        def->deleteMe();
+}
+
 extern "C" XI_EXPORT bool run(const char* context)
 {
     _app = Application::get();
@@ -754,30 +6099,37 @@ extern "C" XI_EXPORT bool run(const char* context)
 
     LogFusion("Thick Line Add-In started.\n");
 
-    // Create a command definition and add a button to the CREATE panel.
-    Ptr<CommandDefinition> cmdDef = _ui->commandDefinitions()->addButtonDefinition(
-        "habiThickLineAddIn", "Thick Line", "Creates a Thick Line with features", "Resources/Icons");
-    if (!cmdDef)
-        return false;
-
+    // Add the commands to the CREATE panel of the sketch workspace.
     Ptr<ToolbarPanel> createPanel = _ui->allToolbarPanels()->itemById("SketchCreatePanel");
     if (!createPanel)
         return false;
 
-    Ptr<CommandControl> gearButton = createPanel->controls()->addCommand(cmdDef);
-    if (!gearButton)
-        return false;
-    // Promote it to show as a top-level icon in the panel
-    gearButton->isPromoted(true);              // promote this instance now
-
-    // Connect to the command created event.
-    Ptr<CommandCreatedEvent> commandCreatedEvent = cmdDef->commandCreated();
-    if (!commandCreatedEvent)
-        return false;
-
-    bool isOk = commandCreatedEvent->add(&_thickLineCommandCreatedHandler);
-    if (!isOk)
+    if (!addPanelCommand(createPanel, "habiThickLineAddIn", "Thick Line", "Creates a Thick Line with features",
+                         &_thickLineCommandCreatedHandler, true))
         return false;
+    addPanelCommand(createPanel, kCopyCmdId, "Copy Thick Lines", "Copies the parameters of the selected thick lines",
+                    &_thickLineCopyCommandCreatedHandler);
+    addPanelCommand(createPanel, kImportCmdId, "Import Thick Lines", "Creates thick lines from a CSV file in the active sketch",
+                    &_thickLineImportCommandCreatedHandler);
+    addPanelCommand(createPanel, kLibExportCmdId, "Export Thick Line Library", "Saves the thick lines of the active sketch to a library file",
+                    &_thickLineLibCommandCreatedHandler);
+    addPanelCommand(createPanel, kLibImportCmdId, "Import Thick Line Library", "Creates the thick lines of a library file in the active sketch",
+                    &_thickLineLibCommandCreatedHandler);
+    addPanelCommand(createPanel, kPickCmdId, "Select Thick Lines", "Click inside thick lines to select all their curves",
+                    &_thickLinePickCommandCreatedHandler);
+    addPanelCommand(createPanel, kCleanCmdId, "Clean Up Thick Lines", "Repairs or removes partly deleted thick lines in the active sketch",
+                    &_thickLineCleanCommandCreatedHandler);
+    addPanelCommand(createPanel, kCoverageCmdId, "Thick Line Coverage", "Writes the covered area per tile of the active sketch and a heatmap",
+                    &_thickLineCoverageCommandCreatedHandler);
+    addPanelCommand(createPanel, kDxfExportCmdId, "Export Thick Lines as DXF", "Writes the outlines of the thick lines in the active sketch to a DXF file",
+                    &_thickLineDxfExportCommandCreatedHandler);
+    addPanelCommand(createPanel, kPasteCmdId, "Paste Thick Lines", "Regenerates the copied thick lines in the active sketch",
+                    &_thickLinePasteCommandCreatedHandler);
+
+#ifdef THICKLINE_BENCH
+    addPanelCommand(createPanel, kBenchCmdId, "Thick Line Benchmark", "Compares emit strategies on a synthetic batch",
+                    &_thickLineBenchCommandCreatedHandler);
+#endif
 
     std::string strContext = context;
     if (strContext.find("IsApplicationStartup", 0) != std::string::npos)
@@ -797,13 +6149,20 @@ extern "C" XI_EXPORT bool stop(const char* context)
         if (!createPanel)
             return false;
 
-        Ptr<CommandControl> gearButton = createPanel->controls()->itemById("habiThickLineAddIn");
-        if (gearButton)
-            gearButton->deleteMe();
-
-        Ptr<CommandDefinition> cmdDef = _ui->commandDefinitions()->itemById("habiThickLineAddIn");
-        if (cmdDef)
-            cmdDef->deleteMe();
+        removePanelCommand(createPanel, "habiThickLineAddIn");
+        removePanelCommand(createPanel, kCopyCmdId);
+        removePanelCommand(createPanel, kPasteCmdId);
+        removePanelCommand(createPanel, kImportCmdId);
+        removePanelCommand(createPanel, kPickCmdId);
+        removePanelCommand(createPanel, kCleanCmdId);
+        removePanelCommand(createPanel, kCoverageCmdId);
+        removePanelCommand(createPanel, kDxfExportCmdId);
+        removePanelCommand(createPanel, kLibExportCmdId);
+        removePanelCommand(createPanel, kLibImportCmdId);
+#ifdef THICKLINE_BENCH
+        removePanelCommand(createPanel, kBenchCmdId);
+#endif
+        g_SketchIndexes.clear();
 
 		LogFusion("Thick Line Add-In stopped.\n");
     }